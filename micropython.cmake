@@ -16,11 +16,27 @@ target_include_directories(usermod_pydisplay INTERFACE
 if(DEFINED IDF_PATH)
     target_sources(usermod_pydisplay INTERFACE
         ${CMOD_DIR}/src/buses/common/common.c
+        ${CMOD_DIR}/src/buses/common/registry.c
+        ${CMOD_DIR}/src/buses/common/rows.c
+        ${CMOD_DIR}/src/buses/common/te.c
         ${CMOD_DIR}/src/buses/esp32/spibus.c
         ${CMOD_DIR}/src/buses/esp32/i80bus.c
         ${CMOD_DIR}/src/rgbframebuffer/esp32/rgbframebuffer.c
         )
 
+    # jpegdec decodes with the copy of TJpgDec in ROM, which not every target has
+    set(ROM_CAPS ${IDF_PATH}/components/esp_rom/${IDF_TARGET}/esp_rom_caps.h)
+    if(EXISTS ${ROM_CAPS})
+        file(STRINGS ${ROM_CAPS} ROM_HAS_JPEG_DECODE
+            REGEX "#define[ \t]+ESP_ROM_HAS_JPEG_DECODE[ \t]+\\(1\\)")
+    endif()
+    if(ROM_HAS_JPEG_DECODE)
+        target_sources(usermod_pydisplay INTERFACE
+            ${CMOD_DIR}/src/jpegdec/jpegdec_core.c
+            ${CMOD_DIR}/src/jpegdec/esp32/jpegdec.c
+            )
+    endif()
+
     target_include_directories(usermod_pydisplay INTERFACE
         ${IDF_PATH}/components/esp_lcd/include/
         )
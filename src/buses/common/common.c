@@ -13,18 +13,179 @@
 #include "py/runtime.h"
 #include "py/mphal.h"
 #include "py/objexcept.h"
+#include "py/gc.h"
 #include "shared/runtime/pyexec.h"
 
 #include "common.h"
+#include "rows.h"
+
+// The owner may be a stale pointer into the heap of a previous session if its
+// finaliser never ran.  Only trust it if it is still an allocated bus holding
+// the handles it registered.
+static bool bus_owner_alive(const registry_entry_t *entry) {
+    bus_obj_t *owner = entry->owner;
+    if (gc_nbytes(owner) < sizeof(bus_obj_t)) {
+        return false;
+    }
+    return owner->base.type == entry->type && owner->io_handle == entry->handles[BUS_HANDLE_IO].handle;
+}
+
+// Make a bus that lost its handles raise instead of using them
+static void bus_detach(void *owner_in) {
+    bus_obj_t *owner = (bus_obj_t *)owner_in;
+    owner->io_handle = NULL;
+    owner->bus_handle = NULL;
+    owner->trans_done = true;
+    owner->te.gpio = -1;
+    owner->te.sync = false;
+    owner->te.pacing = false;
+}
+
+static registry_entry_t bus_registry_entries[BUS_REGISTRY_SIZE];
+
+static registry_t bus_registry = {
+    .entries = bus_registry_entries,
+    .size = BUS_REGISTRY_SIZE,
+    .owner_alive = bus_owner_alive,
+    .detach = bus_detach,
+};
+
+static int bus_del_io(void *io_handle) {
+    return esp_lcd_panel_io_del((esp_lcd_panel_io_handle_t)io_handle);
+}
+
+// Remove the TE interrupt and return the pin to its reset state, so it no
+// longer raises edge interrupts
+static int bus_del_te(void *gpio_in) {
+    gpio_num_t gpio = (gpio_num_t)(intptr_t)gpio_in;
+    esp_err_t ret = gpio_isr_handler_remove(gpio);
+    if (ret == ESP_OK) {
+        ret = gpio_reset_pin(gpio);
+    }
+    return ret;
+}
+
+// Reserve the registry entry for (type, id) before any hardware is allocated,
+// releasing whatever an earlier bus left there.
+registry_entry_t *bus_claim(const mp_obj_type_t *type, int id) {
+    int err;
+    registry_entry_t *entry = registry_claim(&bus_registry, type, id, &err);
+    if (entry == NULL) {
+        if (err != 0) {
+            mp_raise_msg(&mp_type_OSError, "Failed to release the previous bus");
+        }
+        mp_raise_msg(&mp_type_RuntimeError, "Too many buses in use");
+    }
+    return entry;
+}
+
+// Record the handles of a newly created bus.  The TE pin, if any, is added
+// by te_init once its interrupt is installed.
+void bus_register(bus_obj_t *self, registry_entry_t *entry) {
+    self->te.gpio = -1;
+    registry_own(&bus_registry, entry, self);
+    entry->handles[BUS_HANDLE_IO] = (registry_handle_t){ self->io_handle, bus_del_io };
+    entry->handles[BUS_HANDLE_BUS] = (registry_handle_t){ self->bus_handle, self->del_bus };
+}
+
+static void te_isr(void *arg) {
+    bus_obj_t *self = (bus_obj_t *)arg;
+    te_edge(&self->te, (uint32_t)esp_timer_get_time());
+    mp_hal_wake_main_task_from_isr();
+}
+
+// Configure the TE input.  This runs after the bus is registered, so on failure
+// deinit() tears everything down through the registry.
+void te_init(bus_obj_t *self, registry_entry_t *entry, int gpio) {
+    memset(&self->te, 0, sizeof(self->te));
+    self->te.gpio = -1;
+    if (gpio < 0) {
+        return;
+    }
+    if (!GPIO_IS_VALID_GPIO(gpio)) {
+        deinit(MP_OBJ_FROM_PTR(self));
+        mp_raise_ValueError("Invalid TE pin");
+    }
+
+    gpio_config_t io_conf = {
+        .pin_bit_mask = 1ULL << gpio,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_POSEDGE,
+    };
+    esp_err_t ret = gpio_config(&io_conf);
+    if (ret == ESP_OK) {
+        // machine.Pin may have installed the service already
+        ret = gpio_install_isr_service(0);
+        if (ret == ESP_ERR_INVALID_STATE) {
+            ret = ESP_OK;
+        }
+    }
+    if (ret == ESP_OK) {
+        ret = gpio_isr_handler_add(gpio, te_isr, self);
+    }
+    if (ret != ESP_OK) {
+        gpio_reset_pin(gpio);
+        deinit(MP_OBJ_FROM_PTR(self));
+        mp_raise_msg(&mp_type_OSError, "Failed to configure TE pin");
+    }
+    // From here on releasing the bus removes the handler
+    self->te.gpio = gpio;
+    entry->handles[BUS_HANDLE_TE] = (registry_handle_t){ (void *)(intptr_t)gpio, bus_del_te };
+}
+
+// Wait for the next TE edge plus the configured delay.  The TE interrupt wakes
+// the main task, so this sleeps rather than spins.  Panels don't drive TE until
+// TEON (0x35) is sent, so the wait is bounded.
+static uint32_t te_wait(bus_obj_t *self) {
+    volatile bus_te_t *te = &self->te;
+    uint32_t frame = te->frames;
+    te_account(te, frame);
+
+    uint32_t timeout = te->period > 0 ? TE_TIMEOUT_PERIODS * te->period : TE_TIMEOUT_US;
+    uint32_t start = (uint32_t)esp_timer_get_time();
+    while (te->frames == frame) {
+        if ((uint32_t)esp_timer_get_time() - start > timeout) {
+            te->pacing = false;
+            mp_raise_msg(&mp_type_OSError, "Timed out waiting for TE.  Was TEON (0x35) sent?");
+        }
+        #ifdef MICROPY_EVENT_POLL_HOOK
+        MICROPY_EVENT_POLL_HOOK
+        #else
+        mp_event_wait_ms(1);
+        #endif
+    }
+
+    // Snapshot frames and last together, as the interrupt may update them
+    uint32_t last;
+    do {
+        frame = te->frames;
+        last = te->last;
+    } while (frame != te->frames);
+    te_synced(te, frame);
+
+    if (te->delay > 0) {
+        uint32_t elapsed = (uint32_t)esp_timer_get_time() - last;
+        if (elapsed < te->delay) {
+            mp_hal_delay_us(te->delay - elapsed);
+        }
+    }
+    return frame;
+}
 
 bool color_trans_done(void *panel_io, void *edata, void *user_ctx) {
     bus_obj_t *self = (bus_obj_t *)user_ctx;
     self->trans_done = true;
+    self->trans_count++;
     return false;
 }
 
 mp_obj_t send(size_t n_args, const mp_obj_t *args) {
     bus_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+    if (self->io_handle == NULL) {
+        mp_raise_msg(&mp_type_OSError, "Bus is deinitialized");
+    }
     int cmd = mp_obj_get_int(args[1]);
     void *buf = NULL;
     int len = 0;
@@ -44,6 +205,9 @@ mp_obj_t send(size_t n_args, const mp_obj_t *args) {
 
 mp_obj_t send_color(size_t n_args, const mp_obj_t *args) {    
     bus_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+    if (self->io_handle == NULL) {
+        mp_raise_msg(&mp_type_OSError, "Bus is deinitialized");
+    }
     int cmd = mp_obj_get_int(args[1]);
     void *buf = NULL;
     int len = 0;
@@ -57,6 +221,9 @@ mp_obj_t send_color(size_t n_args, const mp_obj_t *args) {
     while (self->trans_done == false) {
         mp_handle_pending(true);
     }
+    if (self->te.sync) {
+        te_wait(self);
+    }
     self->trans_done = false;
     int ret = self->tx_color(self->io_handle, cmd, buf, len);
     if (ret != 0) {
@@ -68,3 +235,162 @@ mp_obj_t send_color(size_t n_args, const mp_obj_t *args) {
 
     return mp_const_none;
 }
+
+static int bus_tx_color(void *ctx, int cmd, const void *buf, size_t len) {
+    bus_obj_t *self = (bus_obj_t *)ctx;
+    return self->tx_color(self->io_handle, cmd, buf, len);
+}
+
+static void *bus_dma_malloc(size_t size) {
+    return heap_caps_malloc(size, MALLOC_CAP_DMA);
+}
+
+///
+/// send_rect(cmd, buf, stride, x, y, w, h) - Send a sub-rectangle of a larger RGB565 buffer.
+///
+/// Parameters:
+///   - cmd: command that starts the memory write, e.g. RAMWR
+///   - buf: buffer holding the whole canvas
+///   - stride: width of the canvas in pixels
+///   - x, y, w, h: rectangle within the canvas to send
+///
+/// The rows are sent from buf in place when the bus's DMA can read them there.
+/// Otherwise they are copied, in small chunks, into DMA-capable staging memory.
+/// The panel window must already be set.
+///
+mp_obj_t send_rect(size_t n_args, const mp_obj_t *args) {
+    bus_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+    if (self->io_handle == NULL) {
+        mp_raise_msg(&mp_type_OSError, "Bus is deinitialized");
+    }
+    int cmd = mp_obj_get_int(args[1]);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[2], &bufinfo, MP_BUFFER_READ);
+    mp_int_t stride = mp_obj_get_int(args[3]);
+    mp_int_t x = mp_obj_get_int(args[4]);
+    mp_int_t y = mp_obj_get_int(args[5]);
+    mp_int_t w = mp_obj_get_int(args[6]);
+    mp_int_t h = mp_obj_get_int(args[7]);
+
+    size_t offset;
+    if (stride < 0 || x < 0 || y < 0 || w < 0 || h < 0 ||
+        !rows_rect_offset(bufinfo.len, stride, x, y, w, h, &offset)) {
+        mp_raise_ValueError("send_rect: rectangle out of bounds");
+    }
+
+    const uint8_t *src = (const uint8_t *)bufinfo.buf + 2 * offset;
+    size_t pitch = 2 * (size_t)stride;
+    size_t row_len = 2 * (size_t)w;
+    size_t rows = h;
+
+    rows_io_t io = {
+        .ctx = self,
+        .tx_color = bus_tx_color,
+        .trans_count = &self->trans_count,
+        .dma_malloc = bus_dma_malloc,
+        .dma_free = heap_caps_free,
+    };
+
+    while (self->trans_done == false) {
+        mp_handle_pending(true);
+    }
+    if (self->te.sync) {
+        te_wait(self);
+    }
+
+    int ret;
+    if (self->dma_capable(src, pitch, row_len)) {
+        if (pitch == row_len) {
+            // Whole rows are contiguous, so send them as a single transfer
+            row_len *= rows;
+            pitch = row_len;
+            rows = 1;
+        }
+        ret = rows_send(&io, cmd, src, pitch, row_len, rows);
+    } else {
+        // Staged row by row even when contiguous, so the chunks stay small
+        ret = rows_send_staged(&io, cmd, src, pitch, row_len, rows, BUS_STAGING_SIZE);
+    }
+    if (ret != 0) {
+        mp_raise_msg(&mp_type_OSError, "Failed to send color data");
+    }
+
+    return mp_const_none;
+}
+
+///
+/// wait_frame() - Wait for the next TE edge, plus the te_sync delay.
+///
+/// Returns the frame number.
+///
+mp_obj_t wait_frame(mp_obj_t self_in) {
+    bus_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->te.gpio < 0) {
+        mp_raise_msg(&mp_type_OSError, "Bus has no TE pin");
+    }
+    return mp_obj_new_int_from_uint(te_wait(self));
+}
+
+///
+/// te_sync(enable, delay=0) - Start send_color and send_rect on a TE edge.
+///
+/// Parameters:
+///   - enable: wait for the next TE edge before each color transfer
+///   - delay: us to wait after the edge, to start at a chosen scanline.  Must be
+///     less than one frame period.
+///
+/// Missed frame counting restarts on every call.
+///
+mp_obj_t te_sync(size_t n_args, const mp_obj_t *args) {
+    bus_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+    bool enable = mp_obj_is_true(args[1]);
+    if (enable && self->te.gpio < 0) {
+        mp_raise_msg(&mp_type_OSError, "Bus has no TE pin");
+    }
+    mp_int_t delay = n_args > 2 ? mp_obj_get_int(args[2]) : 0;
+    uint32_t period = self->te.period;
+    if (delay < 0 || (period > 0 && (mp_uint_t)delay >= period) || delay > TE_TIMEOUT_US) {
+        mp_raise_ValueError("te_sync: delay must be at least 0 and less than one frame");
+    }
+    self->te.sync = enable;
+    self->te.delay = delay;
+    self->te.pacing = false;
+    return mp_const_none;
+}
+
+///
+/// frame_stats() - Return (frames, refresh rate in Hz, missed frames).
+///
+/// Missed frames are TE edges that passed between two paced waits without a
+/// transfer.  A gap of more than a few frames counts as idle time instead.
+///
+mp_obj_t frame_stats(mp_obj_t self_in) {
+    bus_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    volatile bus_te_t *te = &self->te;
+    uint32_t period = te->period;
+    mp_obj_t stats[3] = {
+        mp_obj_new_int_from_uint(te->frames),
+        mp_obj_new_float(period > 0 ? 1000000.0f / period : 0.0f),
+        mp_obj_new_int_from_uint(te->missed),
+    };
+    return mp_obj_new_tuple(3, stats);
+}
+
+mp_obj_t deinit(mp_obj_t self_in) {
+    bus_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->io_handle == NULL) {
+        return mp_const_none;
+    }
+    // A newer bus on the same id takes the entry over and detaches this object,
+    // so an entry owned by another object is never released here.
+    int ret = registry_release_owned(&bus_registry, self->base.type, self->id, self);
+    bus_detach(self);
+    if (ret != 0) {
+        mp_raise_msg(&mp_type_OSError, "Failed to release bus");
+    }
+    return mp_const_none;
+}
+
+mp_obj_t deinit_exit(size_t n_args, const mp_obj_t *args) {
+    return deinit(args[0]);
+}
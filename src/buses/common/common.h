@@ -16,5 +16,14 @@
 bool color_trans_done(void *panel_io, void *edata, void *user_ctx);
 mp_obj_t send(size_t n_args, const mp_obj_t *args);
 mp_obj_t send_color(size_t n_args, const mp_obj_t *args);
+mp_obj_t send_rect(size_t n_args, const mp_obj_t *args);
+registry_entry_t *bus_claim(const mp_obj_type_t *type, int id);
+void bus_register(bus_obj_t *self, registry_entry_t *entry);
+void te_init(bus_obj_t *self, registry_entry_t *entry, int gpio);
+mp_obj_t wait_frame(mp_obj_t self_in);
+mp_obj_t te_sync(size_t n_args, const mp_obj_t *args);
+mp_obj_t frame_stats(mp_obj_t self_in);
+mp_obj_t deinit(mp_obj_t self_in);
+mp_obj_t deinit_exit(size_t n_args, const mp_obj_t *args);
 
 #endif // __COMMON_H__
\ No newline at end of file
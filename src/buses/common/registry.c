@@ -0,0 +1,79 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Brad Barnett
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <string.h>
+
+#include "registry.h"
+
+registry_entry_t *registry_find(registry_t *reg, const void *type, int id) {
+    for (size_t i = 0; i < reg->size; i++) {
+        if (reg->entries[i].type == type && reg->entries[i].id == id) {
+            return &reg->entries[i];
+        }
+    }
+    return NULL;
+}
+
+// Reserve the entry for (type, id) before any hardware is allocated.  Whatever
+// a previous owner left there, e.g. one lost in a soft reset or still alive in
+// this session, is released first.  Returns NULL with *err set if that release
+// failed, or with *err 0 if the registry is full.
+registry_entry_t *registry_claim(registry_t *reg, const void *type, int id, int *err) {
+    *err = 0;
+    registry_entry_t *entry = registry_find(reg, type, id);
+    if (entry != NULL) {
+        *err = registry_release(reg, entry);
+        if (*err != 0) {
+            return NULL;
+        }
+    } else {
+        entry = registry_find(reg, NULL, 0);
+        if (entry == NULL) {
+            return NULL;
+        }
+    }
+    entry->type = type;
+    entry->id = id;
+    return entry;
+}
+
+// Hand the entry to a new owner, detaching the previous one if it is alive
+void registry_own(registry_t *reg, registry_entry_t *entry, void *owner) {
+    if (entry->owner != owner && entry->owner != NULL && reg->owner_alive(entry)) {
+        reg->detach(entry->owner);
+    }
+    entry->owner = owner;
+}
+
+// Detach the owner and free the handles in order.  A later handle may depend on
+// an earlier one, so this stops at the first failure and keeps the entry, with
+// the handles still held, for the next claim to retry.
+int registry_release(registry_t *reg, registry_entry_t *entry) {
+    registry_own(reg, entry, NULL);
+    for (size_t i = 0; i < REGISTRY_HANDLES; i++) {
+        registry_handle_t *h = &entry->handles[i];
+        if (h->del != NULL) {
+            int ret = h->del(h->handle);
+            if (ret != 0) {
+                return ret;
+            }
+            h->del = NULL;
+            h->handle = NULL;
+        }
+    }
+    memset(entry, 0, sizeof(*entry));
+    return 0;
+}
+
+// Release the entry for (type, id) only if owner holds it.  An object that was
+// taken over has already been detached and must not free its successor's handles.
+int registry_release_owned(registry_t *reg, const void *type, int id, const void *owner) {
+    registry_entry_t *entry = registry_find(reg, type, id);
+    if (entry == NULL || entry->owner != owner) {
+        return 0;
+    }
+    return registry_release(reg, entry);
+}
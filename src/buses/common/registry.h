@@ -0,0 +1,51 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Brad Barnett
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Registry of driver handles that outlive a soft reset.  Handles are freed
+ * through the delete functions stored with them and owners are checked and
+ * detached through the registry's callbacks, so this builds without the
+ * MicroPython runtime or esp_lcd.
+ */
+
+#ifndef __REGISTRY_H__
+#define __REGISTRY_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define REGISTRY_HANDLES (3)
+
+typedef struct _registry_handle_t {
+    void *handle;
+    int (*del)(void *handle);               // NULL once released, returns 0 on success
+} registry_handle_t;
+
+typedef struct _registry_entry_t {
+    const void *type;                       // NULL if the entry is free
+    int id;                                 // key, unique per type
+    void *owner;                            // may be stale after a soft reset
+    registry_handle_t handles[REGISTRY_HANDLES];  // released in order
+} registry_entry_t;
+
+typedef struct _registry_t registry_t;
+
+struct _registry_t {
+    registry_entry_t *entries;
+    size_t size;
+    // Whether the owner is still a live object holding the entry's handles
+    bool (*owner_alive)(const registry_entry_t *entry);
+    // Stop a live owner from using the handles
+    void (*detach)(void *owner);
+};
+
+registry_entry_t *registry_find(registry_t *reg, const void *type, int id);
+registry_entry_t *registry_claim(registry_t *reg, const void *type, int id, int *err);
+void registry_own(registry_t *reg, registry_entry_t *entry, void *owner);
+int registry_release(registry_t *reg, registry_entry_t *entry);
+int registry_release_owned(registry_t *reg, const void *type, int id, const void *owner);
+
+#endif // __REGISTRY_H__
@@ -0,0 +1,83 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Brad Barnett
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <string.h>
+
+#include "rows.h"
+
+// Check that a w x h rectangle at (x, y) lies within a buf_len byte RGB565
+// buffer of the given stride in pixels, without overflowing, and return the
+// pixel offset of its first pixel.
+bool rows_rect_offset(size_t buf_len, size_t stride, size_t x, size_t y, size_t w, size_t h, size_t *offset) {
+    size_t pixels = buf_len / 2;
+    if (w == 0 || h == 0 || w > stride || x > stride - w || x + w > pixels) {
+        return false;
+    }
+    // The last row only needs x + w pixels
+    size_t full_rows = (pixels - (x + w)) / stride;
+    if (y > full_rows || h - 1 > full_rows - y) {
+        return false;
+    }
+    *offset = y * stride + x;
+    return true;
+}
+
+// Wait until count color transfers have completed since start.  This doesn't
+// handle pending events, so it is safe to use while holding non-GC memory.
+static void rows_wait(const rows_io_t *io, uint32_t start, uint32_t count) {
+    while ((uint32_t)(*io->trans_count - start) < count) {
+    }
+}
+
+// Queue one transfer per row straight from the source buffer.  Only the first
+// row carries the command; the rest continue the memory write.
+int rows_send(const rows_io_t *io, int cmd, const uint8_t *src, size_t pitch, size_t row_len, size_t rows) {
+    uint32_t start = *io->trans_count;
+    for (size_t i = 0; i < rows; i++) {
+        int ret = io->tx_color(io->ctx, i == 0 ? cmd : -1, src + i * pitch, row_len);
+        if (ret != 0) {
+            rows_wait(io, start, i);
+            return ret;
+        }
+    }
+    rows_wait(io, start, rows);
+    return 0;
+}
+
+// Gather rows into two DMA-capable chunks, filling one while the other is sent.
+int rows_send_staged(const rows_io_t *io, int cmd, const uint8_t *src, size_t pitch, size_t row_len, size_t rows, size_t staging_size) {
+    size_t chunk_rows = staging_size / row_len > 0 ? staging_size / row_len : 1;
+    size_t chunk_len = chunk_rows * row_len;
+    uint8_t *chunks[2] = { io->dma_malloc(chunk_len), io->dma_malloc(chunk_len) };
+    if (chunks[0] == NULL || chunks[1] == NULL) {
+        io->dma_free(chunks[0]);
+        io->dma_free(chunks[1]);
+        return -1;
+    }
+
+    uint32_t start = *io->trans_count;
+    int ret = 0;
+    uint32_t k = 0;
+    for (size_t row = 0; row < rows; k++) {
+        size_t n = rows - row < chunk_rows ? rows - row : chunk_rows;
+        uint8_t *chunk = chunks[k & 1];
+        // Transfer k - 2 used this chunk last
+        rows_wait(io, start, k > 0 ? k - 1 : 0);
+        for (size_t i = 0; i < n; i++) {
+            memcpy(chunk + i * row_len, src + (row + i) * pitch, row_len);
+        }
+        ret = io->tx_color(io->ctx, k == 0 ? cmd : -1, chunk, n * row_len);
+        if (ret != 0) {
+            break;
+        }
+        row += n;
+    }
+    rows_wait(io, start, k);
+
+    io->dma_free(chunks[1]);
+    io->dma_free(chunks[0]);
+    return ret;
+}
@@ -0,0 +1,31 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Brad Barnett
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Row transmit for send_rect.  The IO is reached only through the function
+ * pointers in rows_io_t, so this builds without the esp_lcd headers.
+ */
+
+#ifndef __ROWS_H__
+#define __ROWS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct _rows_io_t {
+    void *ctx;                              // passed to tx_color
+    int (*tx_color)(void *ctx, int cmd, const void *buf, size_t len);
+    volatile uint32_t *trans_count;         // incremented as each color transfer completes
+    void *(*dma_malloc)(size_t size);
+    void (*dma_free)(void *ptr);
+} rows_io_t;
+
+bool rows_rect_offset(size_t buf_len, size_t stride, size_t x, size_t y, size_t w, size_t h, size_t *offset);
+int rows_send(const rows_io_t *io, int cmd, const uint8_t *src, size_t pitch, size_t row_len, size_t rows);
+int rows_send_staged(const rows_io_t *io, int cmd, const uint8_t *src, size_t pitch, size_t row_len, size_t rows, size_t staging_size);
+
+#endif // __ROWS_H__
@@ -0,0 +1,38 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Brad Barnett
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "te.h"
+
+// Record a TE edge at time now in us.
+void te_edge(volatile bus_te_t *te, uint32_t now) {
+    // The first edge only sets last.  Checking period as well keeps the average
+    // going when frames wraps.
+    if (te->frames > 0 || te->period > 0) {
+        uint32_t dt = now - te->last;
+        // Exponential moving average over roughly 8 frames
+        te->period = te->period == 0 ? dt : te->period + ((int32_t)(dt - te->period) >> 3);
+    }
+    te->last = now;
+    te->frames++;
+}
+
+// Called when a wait starts at frame.  Edges that passed since the previous
+// paced wait had no transfer and count as missed, unless the gap is so long
+// that the caller was simply idle.
+void te_account(volatile bus_te_t *te, uint32_t frame) {
+    if (te->pacing) {
+        uint32_t gap = frame - te->synced;
+        if (gap <= TE_IDLE_FRAMES) {
+            te->missed += gap;
+        }
+    }
+}
+
+// Called when a wait ends on frame.
+void te_synced(volatile bus_te_t *te, uint32_t frame) {
+    te->synced = frame;
+    te->pacing = true;
+}
@@ -0,0 +1,40 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Brad Barnett
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Tearing effect (TE) frame pacing bookkeeping.  Edges come in through te_edge,
+ * so this builds without the GPIO driver and can be fed by any edge source.
+ */
+
+#ifndef __TE_H__
+#define __TE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// A wait more than this many frames after the previous one is idle time, not
+// missed frames
+#define TE_IDLE_FRAMES (8)
+
+// frames, last and period are written by the TE interrupt.  They are 32 bits
+// so each can be read atomically.
+typedef struct _bus_te_t {
+    int gpio;                               // TE input, -1 if unused
+    bool sync;                              // start color transfers on a TE edge
+    bool pacing;                            // synced is valid
+    uint32_t delay;                         // us to wait after the edge, sets the scanline phase
+    uint32_t frames;                        // TE edges seen
+    uint32_t last;                          // time of the last edge in us, wraps
+    uint32_t period;                        // smoothed frame period in us
+    uint32_t synced;                        // frames at the last wait
+    uint32_t missed;                        // frames skipped between paced waits
+} bus_te_t;
+
+void te_edge(volatile bus_te_t *te, uint32_t now);
+void te_account(volatile bus_te_t *te, uint32_t frame);
+void te_synced(volatile bus_te_t *te, uint32_t frame);
+
+#endif // __TE_H__
@@ -11,14 +11,45 @@
 #include "esp_lcd_panel_io.h"
 #include "esp_lcd_panel_ops.h"
 #include "driver/gpio.h"
+#include "esp_heap_caps.h"
+#include "esp_memory_utils.h"
+#include "esp_timer.h"
 #include "py/mphal.h"
+#include "../common/registry.h"
+#include "../common/te.h"
 
 typedef struct _bus_obj_t {
     mp_obj_base_t base;
     esp_lcd_panel_io_handle_t io_handle;
+    void *bus_handle;                       // SPI host or i80 bus handle, released by del_bus
+    int id;                                 // registry key, unique per bus type
     bool trans_done;
+    uint32_t trans_count;                   // color transfers completed, wraps
     esp_err_t (*tx_param)(esp_lcd_panel_io_handle_t, int, const void *, size_t);
     esp_err_t (*tx_color)(esp_lcd_panel_io_handle_t, int, const void *, size_t);
+    esp_err_t (*del_bus)(void *);
+    bool (*dma_capable)(const void *src, size_t pitch, size_t len);  // can rows be sent in place
+    bus_te_t te;
 } bus_obj_t;
 
+// Bus resources live outside the MicroPython heap, so they outlive a soft reset.
+// The registry remembers them so the next constructor can release them.
+#define BUS_REGISTRY_SIZE (4)
+
+// Registry handles of a bus, in release order: the TE interrupt refers to the
+// bus object and the panel IO to the bus
+enum {
+    BUS_HANDLE_TE,
+    BUS_HANDLE_IO,
+    BUS_HANDLE_BUS,
+};
+
+// How long te_wait waits for an edge: a few frame periods once one has been
+// measured, otherwise long enough for any panel refresh rate
+#define TE_TIMEOUT_PERIODS (4)
+#define TE_TIMEOUT_US (100000)
+
+// Size of the DMA-capable chunks used to gather rows the DMA can't reach
+#define BUS_STAGING_SIZE (4096)
+
 #endif // __BUS_H__
\ No newline at end of file
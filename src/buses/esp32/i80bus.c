@@ -31,6 +31,15 @@
 
 extern const mp_obj_type_t i80bus_type;
 
+static esp_err_t i80bus_del_bus(void *bus_handle) {
+    return esp_lcd_del_i80_bus((esp_lcd_i80_bus_handle_t)bus_handle);
+}
+
+// The i80 bus feeds GDMA straight from the buffer, internal RAM or PSRAM
+static bool i80bus_dma_capable(const void *src, size_t pitch, size_t len) {
+    return esp_ptr_dma_capable(src) || esp_ptr_dma_ext_capable(src);
+}
+
 /// i80bus
 /// Configure a i8080 parallel bus.
 ///
@@ -42,6 +51,11 @@ extern const mp_obj_type_t i80bus_type;
 ///   - freq: pixel clock frequency in Hz
 ///   - cmd_bits: number of bits in a command (8 or 16, default 8)
 ///   - param_bits: number of bits in a parameter (8 or 16, default 8)
+///   - te: tearing effect pin number, -1 if not connected
+///
+/// The bus is released by deinit(), on leaving a with block, when the object is
+/// collected, or when a new I80Bus is created on the same WR pin, which makes
+/// this one raise OSError on use.
 ///
 
 static mp_obj_t i80bus_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args)
@@ -54,6 +68,7 @@ static mp_obj_t i80bus_make_new(const mp_obj_type_t *type, size_t n_args, size_t
         ARG_freq,
         ARG_cmd_bits,
         ARG_param_bits,
+        ARG_te,
     };
 
     static const mp_arg_t allowed_args[] = {
@@ -64,16 +79,23 @@ static mp_obj_t i80bus_make_new(const mp_obj_type_t *type, size_t n_args, size_t
         { MP_QSTR_freq,       MP_ARG_INT  | MP_ARG_KW_ONLY, {.u_int = 2000000 }  },
         { MP_QSTR_cmd_bits,   MP_ARG_INT  | MP_ARG_KW_ONLY, {.u_int = 8 }        },
         { MP_QSTR_param_bits, MP_ARG_INT  | MP_ARG_KW_ONLY, {.u_int = 8 }        },
+        { MP_QSTR_te,         MP_ARG_INT  | MP_ARG_KW_ONLY, {.u_int = -1 }       },
     };
 
     mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
-    bus_obj_t *self = m_new_obj(bus_obj_t);
+    bus_obj_t *self = m_new_obj_with_finaliser(bus_obj_t);
     self->base.type = &i80bus_type;
     self->tx_param = esp_lcd_panel_io_tx_param;
     self->tx_color = esp_lcd_panel_io_tx_color;
+    self->del_bus = i80bus_del_bus;
+    self->dma_capable = i80bus_dma_capable;
     self->trans_done = true;
+    self->trans_count = 0;
+    self->id = args[ARG_wr].u_int;  // a WR pin drives a single i80 bus
+    self->bus_handle = NULL;
+    self->io_handle = NULL;
     esp_err_t ret;
 
     mp_obj_t data = args[ARG_data].u_obj;
@@ -113,11 +135,16 @@ static mp_obj_t i80bus_make_new(const mp_obj_type_t *type, size_t n_args, size_t
         }
     }
 
+    // Take the bus over from any earlier I80Bus on this WR pin, live or lost in
+    // a soft reset
+    registry_entry_t *entry = bus_claim(&i80bus_type, self->id);
+
     esp_lcd_i80_bus_handle_t bus_handle = NULL;
     ret = esp_lcd_new_i80_bus(&bus_config, &bus_handle);
     if (ret != ESP_OK) {
-        mp_raise_msg(&mp_type_OSError, "Failed to create I80Bus.  You must hard reset the board to release the bus.");
+        mp_raise_msg(&mp_type_OSError, "Failed to create I80Bus.  Is the bus in use by another driver?");
     }
+    self->bus_handle = bus_handle;
 
     esp_lcd_panel_io_i80_config_t io_config = {
         .cs_gpio_num = args[ARG_cs].u_int,
@@ -145,8 +172,12 @@ static mp_obj_t i80bus_make_new(const mp_obj_type_t *type, size_t n_args, size_t
     };
     ret = esp_lcd_new_panel_io_i80(bus_handle, &io_config, &self->io_handle);
     if (ret != ESP_OK) {
+        self->io_handle = NULL;
+        esp_lcd_del_i80_bus(bus_handle);
         mp_raise_msg(&mp_type_OSError, "Failed to create I80 panel IO");
     }
+    bus_register(self, entry);
+    te_init(self, entry, args[ARG_te].u_int);
 
     return MP_OBJ_FROM_PTR(self);
 }
@@ -154,10 +185,24 @@ static mp_obj_t i80bus_make_new(const mp_obj_type_t *type, size_t n_args, size_t
 
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(i80bus_send_obj, 1, 3, send);
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(i80bus_send_color_obj, 1, 3, send_color);
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(i80bus_send_rect_obj, 8, 8, send_rect);
+MP_DEFINE_CONST_FUN_OBJ_1(i80bus_wait_frame_obj, wait_frame);
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(i80bus_te_sync_obj, 2, 3, te_sync);
+MP_DEFINE_CONST_FUN_OBJ_1(i80bus_frame_stats_obj, frame_stats);
+MP_DEFINE_CONST_FUN_OBJ_1(i80bus_deinit_obj, deinit);
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(i80bus_exit_obj, 4, 4, deinit_exit);
 
 static const mp_rom_map_elem_t i80bus_locals_dict_table[] = {
     {MP_ROM_QSTR(MP_QSTR_send), MP_ROM_PTR(&i80bus_send_obj)},
     {MP_ROM_QSTR(MP_QSTR_send_color), MP_ROM_PTR(&i80bus_send_color_obj)},
+    {MP_ROM_QSTR(MP_QSTR_send_rect), MP_ROM_PTR(&i80bus_send_rect_obj)},
+    {MP_ROM_QSTR(MP_QSTR_wait_frame), MP_ROM_PTR(&i80bus_wait_frame_obj)},
+    {MP_ROM_QSTR(MP_QSTR_te_sync), MP_ROM_PTR(&i80bus_te_sync_obj)},
+    {MP_ROM_QSTR(MP_QSTR_frame_stats), MP_ROM_PTR(&i80bus_frame_stats_obj)},
+    {MP_ROM_QSTR(MP_QSTR_deinit), MP_ROM_PTR(&i80bus_deinit_obj)},
+    {MP_ROM_QSTR(MP_QSTR___del__), MP_ROM_PTR(&i80bus_deinit_obj)},
+    {MP_ROM_QSTR(MP_QSTR___enter__), MP_ROM_PTR(&mp_identity_obj)},
+    {MP_ROM_QSTR(MP_QSTR___exit__), MP_ROM_PTR(&i80bus_exit_obj)},
 };
 static MP_DEFINE_CONST_DICT(i80bus_locals_dict, i80bus_locals_dict_table);
 
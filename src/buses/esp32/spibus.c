@@ -31,6 +31,16 @@
 
 extern const mp_obj_type_t spibus_type;
 
+static esp_err_t spibus_del_bus(void *bus_handle) {
+    return spi_bus_free((spi_host_device_t)(intptr_t)bus_handle);
+}
+
+// spi_master bounce-copies any transfer that is not in internal DMA memory or
+// not 4-byte aligned in address and length, so only send such rows in place.
+static bool spibus_dma_capable(const void *src, size_t pitch, size_t len) {
+    return esp_ptr_dma_capable(src) && (((uintptr_t)src | pitch | len) & 3) == 0;
+}
+
 ///
 /// spi_bus - Configure a SPI bus.
 ///
@@ -47,6 +57,11 @@ extern const mp_obj_type_t spibus_type;
 ///   - cs: GPIO used for CS line
 ///   - cmd_bits: number of bits in a command (8 or 16, default 8)
 ///   - param_bits: number of bits in a parameter (8 or 16, default 8)
+///   - te: GPIO used for the panel's tearing effect output, -1 if not connected
+///
+/// The bus is released by deinit(), on leaving a with block, when the object is
+/// collected, or when a new SPIBus is created on the same host, which makes this
+/// one raise OSError on use.
 ///
 
 static mp_obj_t spibus_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args){
@@ -63,6 +78,7 @@ static mp_obj_t spibus_make_new(const mp_obj_type_t *type, size_t n_args, size_t
         ARG_cs,         // GPIO used for CS line
         ARG_cmd_bits,   // number of bits in a command (8 or 16, default 8)
         ARG_param_bits, // number of bits in a parameter (8 or 16, default 8)
+        ARG_te,         // GPIO used for the tearing effect output
     };
 
     static const mp_arg_t allowed_args[] = {
@@ -78,18 +94,28 @@ static mp_obj_t spibus_make_new(const mp_obj_type_t *type, size_t n_args, size_t
         { MP_QSTR_cs,               MP_ARG_INT  | MP_ARG_KW_ONLY, {.u_int = -1       } },
         { MP_QSTR_cmd_bits,         MP_ARG_INT  | MP_ARG_KW_ONLY, {.u_int = 8        } },
         { MP_QSTR_param_bits,       MP_ARG_INT  | MP_ARG_KW_ONLY, {.u_int = 8        } },
+        { MP_QSTR_te,               MP_ARG_INT  | MP_ARG_KW_ONLY, {.u_int = -1       } },
     };
 
     mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
-    bus_obj_t *self = m_new_obj(bus_obj_t);
+    bus_obj_t *self = m_new_obj_with_finaliser(bus_obj_t);
     self->base.type = &spibus_type;
     self->tx_param = esp_lcd_panel_io_tx_param;
     self->tx_color = esp_lcd_panel_io_tx_color;
+    self->del_bus = spibus_del_bus;
+    self->dma_capable = spibus_dma_capable;
     self->trans_done = true;
+    self->trans_count = 0;
     esp_err_t ret;
     int spi_host = args[ARG_id].u_int;
+    self->id = spi_host;
+    self->bus_handle = (void *)(intptr_t)spi_host;
+    self->io_handle = NULL;
+
+    // Take the host over from any earlier SPIBus, live or lost in a soft reset
+    registry_entry_t *entry = bus_claim(&spibus_type, spi_host);
 
     spi_bus_config_t buscfg = {
         .sclk_io_num = args[ARG_sck].u_int,
@@ -101,7 +127,7 @@ static mp_obj_t spibus_make_new(const mp_obj_type_t *type, size_t n_args, size_t
     };
     ret = spi_bus_initialize(spi_host, &buscfg, SPI_DMA_CH_AUTO);
     if (ret != ESP_OK) {
-        mp_raise_msg(&mp_type_OSError, "Failed to create SPIBus.  You must hard reset the board to release the bus.");
+        mp_raise_msg(&mp_type_OSError, "Failed to create SPIBus.  Is the host in use by another driver?");
     }
 
     esp_lcd_panel_io_spi_config_t io_config = {
@@ -120,11 +146,14 @@ static mp_obj_t spibus_make_new(const mp_obj_type_t *type, size_t n_args, size_t
         .flags.dc_low_on_data = false,
         .flags.octal_mode = false,
     };
-    self->io_handle = NULL;
     ret = esp_lcd_new_panel_io_spi((esp_lcd_spi_bus_handle_t)spi_host, &io_config, &self->io_handle);
     if (ret != ESP_OK) {
+        self->io_handle = NULL;
+        spi_bus_free(spi_host);
         mp_raise_msg(&mp_type_OSError, "Failed to create SPI panel IO.");
     }
+    bus_register(self, entry);
+    te_init(self, entry, args[ARG_te].u_int);
 
     return MP_OBJ_FROM_PTR(self);
 }
@@ -132,10 +161,24 @@ static mp_obj_t spibus_make_new(const mp_obj_type_t *type, size_t n_args, size_t
 
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(spibus_send_obj, 1, 3, send);
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(spibus_send_color_obj, 1, 3, send_color);
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(spibus_send_rect_obj, 8, 8, send_rect);
+MP_DEFINE_CONST_FUN_OBJ_1(spibus_wait_frame_obj, wait_frame);
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(spibus_te_sync_obj, 2, 3, te_sync);
+MP_DEFINE_CONST_FUN_OBJ_1(spibus_frame_stats_obj, frame_stats);
+MP_DEFINE_CONST_FUN_OBJ_1(spibus_deinit_obj, deinit);
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(spibus_exit_obj, 4, 4, deinit_exit);
 
 static const mp_rom_map_elem_t spibus_locals_dict_table[] = {
     {MP_ROM_QSTR(MP_QSTR_send), MP_ROM_PTR(&spibus_send_obj)},
     {MP_ROM_QSTR(MP_QSTR_send_color), MP_ROM_PTR(&spibus_send_color_obj)},
+    {MP_ROM_QSTR(MP_QSTR_send_rect), MP_ROM_PTR(&spibus_send_rect_obj)},
+    {MP_ROM_QSTR(MP_QSTR_wait_frame), MP_ROM_PTR(&spibus_wait_frame_obj)},
+    {MP_ROM_QSTR(MP_QSTR_te_sync), MP_ROM_PTR(&spibus_te_sync_obj)},
+    {MP_ROM_QSTR(MP_QSTR_frame_stats), MP_ROM_PTR(&spibus_frame_stats_obj)},
+    {MP_ROM_QSTR(MP_QSTR_deinit), MP_ROM_PTR(&spibus_deinit_obj)},
+    {MP_ROM_QSTR(MP_QSTR___del__), MP_ROM_PTR(&spibus_deinit_obj)},
+    {MP_ROM_QSTR(MP_QSTR___enter__), MP_ROM_PTR(&mp_identity_obj)},
+    {MP_ROM_QSTR(MP_QSTR___exit__), MP_ROM_PTR(&spibus_exit_obj)},
 };
 static MP_DEFINE_CONST_DICT(spibus_locals_dict, spibus_locals_dict_table);
 
@@ -0,0 +1,303 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Brad Barnett
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Streaming baseline JPEG decoder built on TJpgDec, from ROM where the target
+ * has it.  The image is decoded one MCU at a time into small staging buffers,
+ * converted to RGB565 and either written into a framebuffer or pushed to a bus,
+ * so the full decoded image never has to exist in RAM.
+ */
+
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/stream.h"
+
+#include "../jpegdec_core.h"
+#include "../../buses/common/common.h"
+
+extern const mp_obj_type_t spibus_type;
+extern const mp_obj_type_t i80bus_type;
+
+static size_t jpegdec_read_stream(jpegdec_ctx_t *ctx, uint8_t *buf, size_t len) {
+    int errcode = 0;
+    mp_uint_t n = mp_stream_rw(MP_OBJ_FROM_PTR(ctx->stream), buf, len, &errcode, MP_STREAM_RW_READ);
+    if (errcode != 0) {
+        ctx->errcode = errcode;
+    }
+    return n;
+}
+
+static void jpegdec_wait(bus_obj_t *bus) {
+    // trans_done is set from the color transfer done ISR
+    while (*(volatile bool *)&bus->trans_done == false) {
+    }
+}
+
+// Send one completed MCU row.  The caller has opened the image window, so the
+// first row starts the memory write with cmd and the rest continue it.  The
+// transfer is left running while the next row decodes into the other buffer.
+static bool jpegdec_send_row(jpegdec_ctx_t *ctx, const uint16_t *row, size_t len, bool first) {
+    bus_obj_t *bus = (bus_obj_t *)ctx->dest;
+
+    jpegdec_wait(bus);
+    bus->trans_done = false;
+    if (bus->tx_color(bus->io_handle, first ? ctx->cmd : -1, row, 2 * len) != ESP_OK) {
+        bus->trans_done = true;
+        return false;
+    }
+    return true;
+}
+
+static void jpegdec_free_rows(jpegdec_ctx_t *ctx) {
+    heap_caps_free(ctx->rows[1]);
+    heap_caps_free(ctx->rows[0]);
+}
+
+static const char *jpegdec_error(JRESULT res) {
+    switch (res) {
+        case JDR_INP:
+            return "JPEG input error";
+        case JDR_MEM1:
+        case JDR_MEM2:
+            return "JPEG decoder out of memory";
+        case JDR_FMT1:
+            return "Invalid JPEG data";
+        case JDR_FMT3:
+            return "Unsupported JPEG format (progressive?)";
+        default:
+            return "Failed to decode JPEG";
+    }
+}
+
+// Raise for a failed decode, preferring the stream's own I/O error
+static void jpegdec_check(jpegdec_ctx_t *ctx, JRESULT res) {
+    if (ctx->errcode != 0) {
+        mp_raise_OSError(ctx->errcode);
+    }
+    if (res != JDR_OK) {
+        mp_raise_msg(&mp_type_ValueError, jpegdec_error(res));
+    }
+}
+
+// Set up the source and parse the JPEG headers
+static void jpegdec_prepare(JDEC *jd, jpegdec_ctx_t *ctx, mp_obj_t src_in, uint8_t *work) {
+    mp_buffer_info_t bufinfo;
+    if (mp_get_buffer(src_in, &bufinfo, MP_BUFFER_READ)) {
+        ctx->src = bufinfo.buf;
+        ctx->src_len = bufinfo.len;
+        ctx->read = NULL;
+    } else {
+        mp_get_stream_raise(src_in, MP_STREAM_OP_READ);
+        ctx->stream = MP_OBJ_TO_PTR(src_in);
+        ctx->read = jpegdec_read_stream;
+    }
+
+    jpegdec_check(ctx, jd_prepare(jd, jpegdec_input, work, JPEGDEC_WORK_SIZE, ctx));
+}
+
+static uint8_t jpegdec_get_scale(mp_int_t scale) {
+    if (scale < 0 || scale > 3) {
+        mp_raise_ValueError("scale must be 0 to 3 (1/1, 1/2, 1/4 or 1/8)");
+    }
+    return scale;
+}
+
+///
+/// info(src) - Return the (width, height) of a JPEG.
+///
+/// Parameters:
+///   - src: buffer holding the JPEG, or a stream to read it from
+///
+static mp_obj_t jpegdec_info(mp_obj_t src_in) {
+    JDEC jd;
+    jpegdec_ctx_t ctx = {0};
+    uint8_t *work = m_new(uint8_t, JPEGDEC_WORK_SIZE);
+
+    jpegdec_prepare(&jd, &ctx, src_in, work);
+    m_del(uint8_t, work, JPEGDEC_WORK_SIZE);
+
+    mp_obj_t size[2] = {
+        MP_OBJ_NEW_SMALL_INT(jd.width),
+        MP_OBJ_NEW_SMALL_INT(jd.height),
+    };
+    return mp_obj_new_tuple(2, size);
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(jpegdec_info_obj, jpegdec_info);
+
+///
+/// decode_into(src, buf, width, *, x=0, y=0, scale=0, swap=False) - Decode a JPEG into a framebuffer.
+///
+/// Parameters:
+///   - src: buffer holding the JPEG, or a stream to read it from
+///   - buf: RGB565 framebuffer, e.g. an RGBFrameBuffer
+///   - width: width of buf in pixels
+///   - x, y: position of the image in buf, the image is clipped to buf
+///   - scale: 0 to 3 to scale the image by 1/1, 1/2, 1/4 or 1/8
+///   - swap: byteswap the RGB565 pixels
+///
+/// Returns the (width, height) of the decoded image.
+///
+static mp_obj_t jpegdec_decode_into(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_src, ARG_buf, ARG_width, ARG_x, ARG_y, ARG_scale, ARG_swap };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_src,      MP_ARG_OBJ  | MP_ARG_REQUIRED                      },
+        { MP_QSTR_buf,      MP_ARG_OBJ  | MP_ARG_REQUIRED                      },
+        { MP_QSTR_width,    MP_ARG_INT  | MP_ARG_REQUIRED                      },
+        { MP_QSTR_x,        MP_ARG_INT  | MP_ARG_KW_ONLY, {.u_int = 0 }        },
+        { MP_QSTR_y,        MP_ARG_INT  | MP_ARG_KW_ONLY, {.u_int = 0 }        },
+        { MP_QSTR_scale,    MP_ARG_INT  | MP_ARG_KW_ONLY, {.u_int = 0 }        },
+        { MP_QSTR_swap,     MP_ARG_BOOL | MP_ARG_KW_ONLY, {.u_bool = false }   },
+    };
+
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[ARG_buf].u_obj, &bufinfo, MP_BUFFER_WRITE);
+    int fb_width = args[ARG_width].u_int;
+    if (fb_width <= 0) {
+        mp_raise_ValueError("width must be positive");
+    }
+    uint8_t scale = jpegdec_get_scale(args[ARG_scale].u_int);
+
+    JDEC jd;
+    jpegdec_ctx_t ctx = {0};
+    ctx.swap = args[ARG_swap].u_bool;
+    ctx.x = args[ARG_x].u_int;
+    ctx.y = args[ARG_y].u_int;
+    ctx.fb = (uint16_t *)bufinfo.buf;
+    ctx.fb_width = fb_width;
+    ctx.fb_height = bufinfo.len / 2 / fb_width;
+
+    uint8_t *work = m_new(uint8_t, JPEGDEC_WORK_SIZE);
+    jpegdec_prepare(&jd, &ctx, args[ARG_src].u_obj, work);
+    ctx.out_width = jd.width >> scale;
+    ctx.out_height = jd.height >> scale;
+
+    JRESULT res = jd_decomp(&jd, jpegdec_output_fb, scale);
+    m_del(uint8_t, work, JPEGDEC_WORK_SIZE);
+    jpegdec_check(&ctx, res);
+
+    mp_obj_t size[2] = {
+        MP_OBJ_NEW_SMALL_INT(ctx.out_width),
+        MP_OBJ_NEW_SMALL_INT(ctx.out_height),
+    };
+    return mp_obj_new_tuple(2, size);
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(jpegdec_decode_into_obj, 2, jpegdec_decode_into);
+
+///
+/// decode_to_bus(src, bus, cmd, *, scale=0, swap=False) - Decode a JPEG straight to a display.
+///
+/// The caller opens a panel window of the scaled image size first, as for
+/// send_rect; see info().  Each MCU row is decoded into a staging buffer and
+/// sent while the next row is decoded.  The first row is sent with cmd and the
+/// following rows continue the memory write.
+///
+/// Parameters:
+///   - src: buffer holding the JPEG, or a stream to read it from
+///   - bus: SPIBus or I80Bus the panel is attached to
+///   - cmd: command that starts the memory write, e.g. RAMWR
+///   - scale: 0 to 3 to scale the image by 1/1, 1/2, 1/4 or 1/8
+///   - swap: byteswap the RGB565 pixels
+///
+/// Returns the (width, height) of the decoded image.
+///
+static mp_obj_t jpegdec_decode_to_bus(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_src, ARG_bus, ARG_cmd, ARG_scale, ARG_swap };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_src,      MP_ARG_OBJ  | MP_ARG_REQUIRED                      },
+        { MP_QSTR_bus,      MP_ARG_OBJ  | MP_ARG_REQUIRED                      },
+        { MP_QSTR_cmd,      MP_ARG_INT  | MP_ARG_REQUIRED                      },
+        { MP_QSTR_scale,    MP_ARG_INT  | MP_ARG_KW_ONLY, {.u_int = 0 }        },
+        { MP_QSTR_swap,     MP_ARG_BOOL | MP_ARG_KW_ONLY, {.u_bool = false }   },
+    };
+
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    mp_obj_t bus_in = args[ARG_bus].u_obj;
+    if (!mp_obj_is_type(bus_in, &spibus_type) && !mp_obj_is_type(bus_in, &i80bus_type)) {
+        mp_raise_TypeError("bus must be an SPIBus or I80Bus");
+    }
+    bus_obj_t *bus = MP_OBJ_TO_PTR(bus_in);
+    if (bus->io_handle == NULL) {
+        mp_raise_msg(&mp_type_OSError, "Bus is deinitialized");
+    }
+    uint8_t scale = jpegdec_get_scale(args[ARG_scale].u_int);
+
+    JDEC jd;
+    jpegdec_ctx_t ctx = {0};
+    ctx.swap = args[ARG_swap].u_bool;
+    ctx.send_row = jpegdec_send_row;
+    ctx.dest = bus;
+    ctx.cmd = args[ARG_cmd].u_int;
+
+    uint8_t *work = m_new(uint8_t, JPEGDEC_WORK_SIZE);
+    jpegdec_prepare(&jd, &ctx, args[ARG_src].u_obj, work);
+    ctx.out_width = jd.width >> scale;
+    ctx.out_height = jd.height >> scale;
+
+    // Wait for the previous color transfer before the first row goes out
+    while (bus->trans_done == false) {
+        mp_handle_pending(true);
+    }
+
+    // The staging rows are read by DMA.  On SPIRAM boards the heap is in PSRAM,
+    // which spi_master would bounce-copy and i80 would read slowly, so they are
+    // allocated from internal DMA-capable memory instead.
+    size_t row_len = jpegdec_row_pixels(&jd, scale);
+    ctx.rows[0] = heap_caps_malloc(2 * row_len, MALLOC_CAP_DMA);
+    ctx.rows[1] = heap_caps_malloc(2 * row_len, MALLOC_CAP_DMA);
+    if (ctx.rows[0] == NULL || ctx.rows[1] == NULL) {
+        jpegdec_free_rows(&ctx);
+        mp_raise_msg(&mp_type_MemoryError, "Failed to allocate JPEG staging rows");
+    }
+
+    JRESULT res;
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        res = jd_decomp(&jd, jpegdec_output_rows, scale);
+        nlr_pop();
+    } else {
+        // Reading the stream raised.  The row in flight must finish before its
+        // staging buffer is freed.
+        jpegdec_wait(bus);
+        jpegdec_free_rows(&ctx);
+        nlr_jump(nlr.ret_val);
+    }
+
+    // Both staging buffers must be idle before they are released
+    jpegdec_wait(bus);
+    jpegdec_free_rows(&ctx);
+    m_del(uint8_t, work, JPEGDEC_WORK_SIZE);
+    if (res == JDR_INTR && ctx.errcode == 0) {
+        mp_raise_msg(&mp_type_OSError, "Failed to send color data");
+    }
+    jpegdec_check(&ctx, res);
+
+    mp_obj_t size[2] = {
+        MP_OBJ_NEW_SMALL_INT(ctx.out_width),
+        MP_OBJ_NEW_SMALL_INT(ctx.out_height),
+    };
+    return mp_obj_new_tuple(2, size);
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(jpegdec_decode_to_bus_obj, 3, jpegdec_decode_to_bus);
+
+
+static const mp_rom_map_elem_t jpegdec_module_globals_table[] = {
+    {MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_jpegdec)},
+    {MP_ROM_QSTR(MP_QSTR_info), MP_ROM_PTR(&jpegdec_info_obj)},
+    {MP_ROM_QSTR(MP_QSTR_decode_into), MP_ROM_PTR(&jpegdec_decode_into_obj)},
+    {MP_ROM_QSTR(MP_QSTR_decode_to_bus), MP_ROM_PTR(&jpegdec_decode_to_bus_obj)},
+};
+static MP_DEFINE_CONST_DICT(mp_module_jpegdec_globals, jpegdec_module_globals_table);
+
+const mp_obj_module_t mp_module_jpegdec = {
+    .base = {&mp_type_module},
+    .globals = (mp_obj_dict_t *)&mp_module_jpegdec_globals,
+};
+MP_REGISTER_MODULE(MP_QSTR_jpegdec, mp_module_jpegdec);
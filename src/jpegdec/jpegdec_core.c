@@ -0,0 +1,109 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Brad Barnett
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <string.h>
+
+#include "jpegdec_core.h"
+
+#define JPEGDEC_MIN(a, b) ((a) < (b) ? (a) : (b))
+
+// Convert a block of RGB888 pixels from the decoder to RGB565 at dest, with
+// the given stride in pixels.
+void jpegdec_convert(bool swap, const uint8_t *src, uint16_t *dest, int stride, int w, int h) {
+    for (int j = 0; j < h; j++) {
+        uint16_t *d = dest + j * stride;
+        for (int i = 0; i < w; i++) {
+            uint16_t c = ((src[0] & 0xF8) << 8) | ((src[1] & 0xFC) << 3) | (src[2] >> 3);
+            src += 3;
+            d[i] = swap ? (c >> 8) | (c << 8) : c;
+        }
+    }
+}
+
+// Pixels in one staging row buffer: the scaled image width times the MCU height
+size_t jpegdec_row_pixels(const JDEC *jd, uint8_t scale) {
+    int mcu_height = (jd->msy * 8) >> scale;
+    return (size_t)(jd->width >> scale) * (mcu_height > 0 ? mcu_height : 1);
+}
+
+jpegdec_len_t jpegdec_input(JDEC *jd, uint8_t *buf, jpegdec_len_t len) {
+    jpegdec_ctx_t *ctx = (jpegdec_ctx_t *)jd->device;
+
+    if (ctx->read == NULL) {
+        if (len > ctx->src_len - ctx->src_pos) {
+            len = ctx->src_len - ctx->src_pos;
+        }
+        if (buf != NULL) {
+            memcpy(buf, ctx->src + ctx->src_pos, len);
+        }
+        ctx->src_pos += len;
+        return len;
+    }
+
+    if (buf != NULL) {
+        return ctx->read(ctx, buf, len);
+    }
+
+    // The decoder asks to skip data by passing a NULL buffer
+    uint8_t skip[JPEGDEC_SKIP_SIZE];
+    jpegdec_len_t done = 0;
+    while (done < len) {
+        size_t chunk = JPEGDEC_MIN(len - done, sizeof(skip));
+        size_t n = ctx->read(ctx, skip, chunk);
+        done += n;
+        if (n < chunk) {
+            break;
+        }
+    }
+    return done;
+}
+
+jpegdec_out_t jpegdec_output_fb(JDEC *jd, void *bitmap, JRECT *rect) {
+    jpegdec_ctx_t *ctx = (jpegdec_ctx_t *)jd->device;
+    int w = rect->right - rect->left + 1;
+    int h = rect->bottom - rect->top + 1;
+    int dx = ctx->x + rect->left;
+    int dy = ctx->y + rect->top;
+    const uint8_t *src = (const uint8_t *)bitmap;
+
+    // Clip the block to the framebuffer
+    int skip_x = dx < 0 ? -dx : 0;
+    int skip_y = dy < 0 ? -dy : 0;
+    int cw = JPEGDEC_MIN(w, ctx->fb_width - dx) - skip_x;
+    int ch = JPEGDEC_MIN(h, ctx->fb_height - dy) - skip_y;
+    if (cw <= 0 || ch <= 0) {
+        return 1;
+    }
+
+    src += 3 * (skip_y * w + skip_x);
+    uint16_t *dest = ctx->fb + (dy + skip_y) * ctx->fb_width + dx + skip_x;
+    for (int j = 0; j < ch; j++) {
+        jpegdec_convert(ctx->swap, src + 3 * j * w, dest + j * ctx->fb_width, ctx->fb_width, cw, 1);
+    }
+    return 1;
+}
+
+// Assemble MCU rows in the staging buffers and hand each completed row to
+// send_row, then switch to the other buffer so decoding overlaps the send.
+jpegdec_out_t jpegdec_output_rows(JDEC *jd, void *bitmap, JRECT *rect) {
+    jpegdec_ctx_t *ctx = (jpegdec_ctx_t *)jd->device;
+    int w = rect->right - rect->left + 1;
+    int h = rect->bottom - rect->top + 1;
+    uint16_t *row = ctx->rows[ctx->row_index];
+
+    // Every block of an MCU row starts at the top of the staging buffer
+    jpegdec_convert(ctx->swap, (const uint8_t *)bitmap, row + rect->left, ctx->out_width, w, h);
+
+    // The last MCU of a row completes it
+    if (rect->right == ctx->out_width - 1) {
+        if (!ctx->send_row(ctx, row, (size_t)ctx->out_width * h, ctx->rows_sent == 0)) {
+            return 0;
+        }
+        ctx->rows_sent++;
+        ctx->row_index ^= 1;
+    }
+    return 1;
+}
@@ -0,0 +1,77 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Brad Barnett
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Input, convert, clip and row assembly core of jpegdec.  It has no MicroPython
+ * or ESP-IDF dependencies so it can also be built on a host.
+ */
+
+#ifndef __JPEGDEC_CORE_H__
+#define __JPEGDEC_CORE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_rom_caps.h"
+#endif
+
+#if defined(ESP_ROM_HAS_JPEG_DECODE) && ESP_ROM_HAS_JPEG_DECODE
+// The ROM copy of TJpgDec (R0.01) outputs RGB888 and uses 32-bit callback types
+#include "rom/tjpgd.h"
+typedef uint32_t jpegdec_len_t;
+typedef uint32_t jpegdec_out_t;
+#else
+// Host builds provide tjpgd.h with the R0.03 API and JD_FORMAT 0 (RGB888).  ESP
+// targets without the ROM copy don't build jpegdec, see micropython.cmake.
+#include "tjpgd.h"
+typedef size_t jpegdec_len_t;
+typedef int jpegdec_out_t;
+#endif
+
+#define JPEGDEC_WORK_SIZE   (3100)  // work area required by the decoder
+#define JPEGDEC_SKIP_SIZE   (64)    // scratch used to skip stream data
+
+typedef struct _jpegdec_ctx_t jpegdec_ctx_t;
+
+struct _jpegdec_ctx_t {
+    // input: a buffer, or a read function if read is set
+    const uint8_t *src;
+    size_t src_len;
+    size_t src_pos;
+    size_t (*read)(jpegdec_ctx_t *ctx, uint8_t *buf, size_t len);
+    void *stream;
+    int errcode;                // set by read on an I/O error
+
+    // output
+    bool swap;                  // byteswap RGB565 pixels
+    int x;                      // framebuffer position of the image
+    int y;
+    uint16_t out_width;         // decoded image size after scaling
+    uint16_t out_height;
+
+    // framebuffer destination
+    uint16_t *fb;
+    int fb_width;
+    int fb_height;
+
+    // row destination, rows are handed to send_row as they complete
+    uint16_t *rows[2];          // ping-pong staging buffers, one MCU row each
+    int row_index;
+    int rows_sent;
+    bool (*send_row)(jpegdec_ctx_t *ctx, const uint16_t *row, size_t len, bool first);
+    void *dest;
+    int cmd;
+};
+
+void jpegdec_convert(bool swap, const uint8_t *src, uint16_t *dest, int stride, int w, int h);
+size_t jpegdec_row_pixels(const JDEC *jd, uint8_t scale);
+jpegdec_len_t jpegdec_input(JDEC *jd, uint8_t *buf, jpegdec_len_t len);
+jpegdec_out_t jpegdec_output_fb(JDEC *jd, void *bitmap, JRECT *rect);
+jpegdec_out_t jpegdec_output_rows(JDEC *jd, void *bitmap, JRECT *rect);
+
+#endif // __JPEGDEC_CORE_H__
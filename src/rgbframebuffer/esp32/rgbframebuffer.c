@@ -6,6 +6,7 @@
 
 
 #include <stdio.h>
+#include <string.h>
 #include "esp_lcd_panel_ops.h"
 #include "esp_lcd_panel_rgb.h"
 #include "esp_lcd_panel_io.h"
@@ -18,6 +19,9 @@
 #include "py/mphal.h"
 #include "py/objarray.h"
 #include "py/binary.h"
+#include "py/gc.h"
+
+#include "../../buses/common/registry.h"
 
 
 typedef struct _rgbframebuffer_obj_t {
@@ -30,6 +34,76 @@ typedef struct _rgbframebuffer_obj_t {
 
 extern const mp_obj_type_t rgbframebuffer_type;
 
+// The panel and its PSRAM framebuffer live outside the MicroPython heap and survive
+// a soft reset.  Remember them so the next RGBFrameBuffer with the same timings and
+// pins can take them over instead of allocating and initializing the panel again.
+// There is a single RGB LCD peripheral, so one entry is enough.
+static struct {
+    esp_lcd_rgb_panel_config_t config;
+    void *buf;
+} rgbframebuffer_panel;
+
+static bool rgbframebuffer_same_config(const esp_lcd_rgb_panel_config_t *a, const esp_lcd_rgb_panel_config_t *b) {
+    if (a->timings.pclk_hz != b->timings.pclk_hz ||
+        a->timings.h_res != b->timings.h_res ||
+        a->timings.v_res != b->timings.v_res ||
+        a->timings.hsync_pulse_width != b->timings.hsync_pulse_width ||
+        a->timings.hsync_front_porch != b->timings.hsync_front_porch ||
+        a->timings.hsync_back_porch != b->timings.hsync_back_porch ||
+        a->timings.vsync_pulse_width != b->timings.vsync_pulse_width ||
+        a->timings.vsync_front_porch != b->timings.vsync_front_porch ||
+        a->timings.vsync_back_porch != b->timings.vsync_back_porch ||
+        a->timings.flags.hsync_idle_low != b->timings.flags.hsync_idle_low ||
+        a->timings.flags.vsync_idle_low != b->timings.flags.vsync_idle_low ||
+        a->timings.flags.de_idle_high != b->timings.flags.de_idle_high ||
+        a->timings.flags.pclk_active_neg != b->timings.flags.pclk_active_neg ||
+        a->timings.flags.pclk_idle_high != b->timings.flags.pclk_idle_high ||
+        a->hsync_gpio_num != b->hsync_gpio_num ||
+        a->vsync_gpio_num != b->vsync_gpio_num ||
+        a->de_gpio_num != b->de_gpio_num ||
+        a->pclk_gpio_num != b->pclk_gpio_num ||
+        a->data_width != b->data_width) {
+        return false;
+    }
+    for (size_t i = 0; i < a->data_width; i++) {
+        if (a->data_gpio_nums[i] != b->data_gpio_nums[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// After a soft reset the owner pointer is stale and is only trusted if it is
+// still an allocated RGBFrameBuffer holding the panel.
+static bool rgbframebuffer_owner_alive(const registry_entry_t *entry) {
+    rgbframebuffer_obj_t *owner = entry->owner;
+    return gc_nbytes(owner) >= sizeof(*owner) &&
+           owner->base.type == &rgbframebuffer_type &&
+           owner->panel_handle == entry->handles[0].handle;
+}
+
+// Stop a previous owner handing out the framebuffer
+static void rgbframebuffer_detach(void *owner_in) {
+    rgbframebuffer_obj_t *owner = (rgbframebuffer_obj_t *)owner_in;
+    owner->panel_handle = NULL;
+    owner->bufinfo.buf = NULL;
+    owner->bufinfo.len = 0;
+}
+
+static registry_entry_t rgbframebuffer_entry;
+
+static registry_t rgbframebuffer_registry = {
+    .entries = &rgbframebuffer_entry,
+    .size = 1,
+    .owner_alive = rgbframebuffer_owner_alive,
+    .detach = rgbframebuffer_detach,
+};
+
+// Frees the PSRAM framebuffer along with the panel
+static int rgbframebuffer_del_panel(void *panel_handle) {
+    return esp_lcd_panel_del((esp_lcd_panel_handle_t)panel_handle);
+}
+
 static mp_obj_t rgbframebuffer_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args) {
     enum { ARG_de, ARG_vsync, ARG_hsync, ARG_dclk, ARG_red, ARG_green, ARG_blue, ARG_frequency, ARG_width, ARG_height, ARG_hsync_pulse_width, ARG_hsync_front_porch, ARG_hsync_back_porch,
     ARG_vsync_pulse_width, ARG_vsync_front_porch, ARG_vsync_back_porch, ARG_hsync_idle_low, ARG_vsync_idle_low,
@@ -63,6 +137,7 @@ static mp_obj_t rgbframebuffer_make_new(const mp_obj_type_t *type, size_t n_args
 
     rgbframebuffer_obj_t *self = m_new_obj(rgbframebuffer_obj_t);
     self->base.type = &rgbframebuffer_type;
+    self->panel_handle = NULL;
     self->width = args[ARG_width].u_int;
     self->height = args[ARG_height].u_int;
     esp_err_t ret;
@@ -128,36 +203,64 @@ static mp_obj_t rgbframebuffer_make_new(const mp_obj_type_t *type, size_t n_args
         panel_config.data_gpio_nums[idx++] = mp_obj_get_int(red->items[i]);
     }
     panel_config.data_width = 16;
+    self->bufinfo.len = 2 * (panel_config.timings.h_res * panel_config.timings.v_res);
+    self->bufinfo.typecode = 'B';
+
+    // A panel left by an earlier RGBFrameBuffer is only complete once it has a buffer
+    registry_entry_t *entry = registry_find(&rgbframebuffer_registry, &rgbframebuffer_type, 0);
+    if (entry != NULL && rgbframebuffer_panel.buf != NULL &&
+        rgbframebuffer_same_config(&rgbframebuffer_panel.config, &panel_config)) {
+        // Take the panel over; a previous owner still alive is detached
+        registry_own(&rgbframebuffer_registry, entry, self);
+        self->panel_handle = entry->handles[0].handle;
+        self->bufinfo.buf = rgbframebuffer_panel.buf;
+        mp_printf(&mp_plat_print, "RGB Framebuffer reused\n");
+        return MP_OBJ_FROM_PTR(self);
+    }
+
+    int err;
+    entry = registry_claim(&rgbframebuffer_registry, &rgbframebuffer_type, 0, &err);
+    if (entry == NULL) {
+        mp_raise_msg(&mp_type_RuntimeError, "Failed to release the previous RGB LCD panel");
+    }
+    rgbframebuffer_panel.buf = NULL;
 
     ret = esp_lcd_new_rgb_panel(&panel_config, &self->panel_handle);
     if (ret != 0) {
+        self->panel_handle = NULL;
         mp_raise_msg(&mp_type_RuntimeError, "Failed to initialize RGB LCD panel");
     }
+    entry->handles[0] = (registry_handle_t){ self->panel_handle, rgbframebuffer_del_panel };
+    registry_own(&rgbframebuffer_registry, entry, self);
+    rgbframebuffer_panel.config = panel_config;
 
     ret = esp_lcd_panel_reset(self->panel_handle);
     if (ret != 0) {
+        registry_release(&rgbframebuffer_registry, entry);
         mp_raise_msg(&mp_type_RuntimeError, "Failed to reset RGB LCD panel");
     }
 
     ret = esp_lcd_panel_init(self->panel_handle);
     if (ret != 0) {
+        registry_release(&rgbframebuffer_registry, entry);
         mp_raise_msg(&mp_type_RuntimeError, "Failed to initialize RGB LCD panel");
     }
 
     uint16_t color = 0xffff;
     ret = esp_lcd_panel_draw_bitmap(self->panel_handle, 0, 0, 1, 1, &color);
     if (ret != 0) {
+        registry_release(&rgbframebuffer_registry, entry);
         mp_raise_msg(&mp_type_RuntimeError, "Failed to draw bitmap on RGB LCD panel");
     }
 
     void *buf;
     ret = esp_lcd_rgb_panel_get_frame_buffer(self->panel_handle, 1, &buf);
     if (ret != 0) {
+        registry_release(&rgbframebuffer_registry, entry);
         mp_raise_msg(&mp_type_RuntimeError, "Failed to get framebuffer from RGB LCD panel");
     }
     self->bufinfo.buf = (uint8_t *)buf;
-    self->bufinfo.len = 2 * (panel_config.timings.h_res * panel_config.timings.v_res);
-    self->bufinfo.typecode = 'B';
+    rgbframebuffer_panel.buf = buf;
 
     mp_printf(&mp_plat_print, "RGB Framebuffer initialized\n");
 
@@ -166,6 +269,9 @@ static mp_obj_t rgbframebuffer_make_new(const mp_obj_type_t *type, size_t n_args
 
 static mp_int_t rgbframebuffer_get_buffer(mp_obj_t self_in, mp_buffer_info_t *bufinfo, mp_uint_t flags) {
     rgbframebuffer_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->panel_handle == NULL) {
+        return 1;
+    }
     *bufinfo = self->bufinfo;
     return 0;
 }
@@ -187,15 +293,42 @@ static mp_obj_t rgbframebuffer_attr(mp_obj_t self_in, qstr attr, mp_obj_t *dest)
 
 static mp_obj_t rgbframebuffer_refresh(mp_obj_t self_in){
     rgbframebuffer_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->panel_handle == NULL) {
+        mp_raise_msg(&mp_type_RuntimeError, "RGBFrameBuffer is deinitialized");
+    }
     Cache_WriteBack_Addr((uint32_t)(self->bufinfo.buf), self->bufinfo.len);
     // call a done callback if desired
     return mp_const_none;
 }
 MP_DEFINE_CONST_FUN_OBJ_1(rgbframebuffer_refresh_obj, rgbframebuffer_refresh);
 
+// There is deliberately no __del__: letting the panel outlive a soft reset is what
+// allows the next RGBFrameBuffer to reuse it.
+static mp_obj_t rgbframebuffer_deinit(mp_obj_t self_in) {
+    rgbframebuffer_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->panel_handle == NULL) {
+        return mp_const_none;
+    }
+    int ret = registry_release_owned(&rgbframebuffer_registry, &rgbframebuffer_type, 0, self);
+    rgbframebuffer_detach(self);
+    if (ret != 0) {
+        mp_raise_msg(&mp_type_RuntimeError, "Failed to release RGB LCD panel");
+    }
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_1(rgbframebuffer_deinit_obj, rgbframebuffer_deinit);
+
+static mp_obj_t rgbframebuffer_exit(size_t n_args, const mp_obj_t *args) {
+    return rgbframebuffer_deinit(args[0]);
+}
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(rgbframebuffer_exit_obj, 4, 4, rgbframebuffer_exit);
+
 
 static const mp_rom_map_elem_t rgbframebuffer_locals_dict_table[] = {
     {MP_ROM_QSTR(MP_QSTR_refresh), MP_ROM_PTR(&rgbframebuffer_refresh_obj)},
+    {MP_ROM_QSTR(MP_QSTR_deinit), MP_ROM_PTR(&rgbframebuffer_deinit_obj)},
+    {MP_ROM_QSTR(MP_QSTR___enter__), MP_ROM_PTR(&mp_identity_obj)},
+    {MP_ROM_QSTR(MP_QSTR___exit__), MP_ROM_PTR(&rgbframebuffer_exit_obj)},
 };
 static MP_DEFINE_CONST_DICT(rgbframebuffer_locals_dict, rgbframebuffer_locals_dict_table);
 
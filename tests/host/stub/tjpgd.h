@@ -0,0 +1,41 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Brad Barnett
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * The parts of the TJpgDec R0.03 API that jpegdec_core uses, so the core can be
+ * checked on a host without the decoder itself.
+ */
+
+#ifndef __TJPGD_STUB_H__
+#define __TJPGD_STUB_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    JDR_OK = 0,
+    JDR_INTR,
+    JDR_INP,
+    JDR_MEM1,
+    JDR_MEM2,
+    JDR_PAR,
+    JDR_FMT1,
+    JDR_FMT2,
+    JDR_FMT3
+} JRESULT;
+
+typedef struct {
+    uint16_t left, right, top, bottom;
+} JRECT;
+
+typedef struct JDEC JDEC;
+struct JDEC {
+    uint8_t msx, msy;                       // MCU size in blocks
+    uint16_t width, height;                 // image size
+    void *device;
+};
+
+#endif // __TJPGD_STUB_H__
@@ -0,0 +1,173 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Brad Barnett
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * jpegdec core: input and skip, RGB565 conversion, framebuffer clipping and
+ * MCU row assembly, driven with synthetic decoder output.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "check.h"
+#include "jpegdec_core.h"
+
+// RGB888 pixel for a test value, distinct for every v below 256
+#define PIX(v) (uint8_t)(v), (uint8_t)((v) * 3), (uint8_t)((v) * 7)
+
+static uint16_t rgb565(int v) {
+    uint8_t p[3] = { PIX(v) };
+    return ((p[0] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[2] >> 3);
+}
+
+static void test_convert(void) {
+    const uint8_t src[] = { 0xFF, 0x00, 0x00, 0x12, 0x34, 0x56 };
+    uint16_t dest[2];
+    jpegdec_convert(false, src, dest, 2, 2, 1);
+    CHECK(dest[0] == 0xF800 && dest[1] == 0x11AA);
+    jpegdec_convert(true, src, dest, 2, 2, 1);
+    CHECK(dest[0] == 0x00F8 && dest[1] == 0xAA11);
+}
+
+static const uint8_t *stream_data;
+static size_t stream_len, stream_pos, stream_max_chunk;
+
+static size_t stream_read(jpegdec_ctx_t *ctx, uint8_t *buf, size_t len) {
+    (void)ctx;
+    if (len > stream_max_chunk) {
+        stream_max_chunk = len;
+    }
+    if (len > stream_len - stream_pos) {
+        len = stream_len - stream_pos;
+    }
+    memcpy(buf, stream_data + stream_pos, len);
+    stream_pos += len;
+    return len;
+}
+
+static void test_input(void) {
+    uint8_t data[200];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)i;
+    }
+    uint8_t buf[8];
+
+    // From a buffer
+    jpegdec_ctx_t ctx = { .src = data, .src_len = 10 };
+    JDEC jd = { .device = &ctx };
+    CHECK(jpegdec_input(&jd, buf, 4) == 4 && buf[3] == 3);
+    CHECK(jpegdec_input(&jd, NULL, 3) == 3 && ctx.src_pos == 7);
+    CHECK(jpegdec_input(&jd, buf, 5) == 3 && buf[0] == 7 && buf[2] == 9);
+    CHECK(jpegdec_input(&jd, buf, 5) == 0);
+
+    // From a stream, skipping through the small scratch buffer
+    ctx = (jpegdec_ctx_t){ .read = stream_read };
+    stream_data = data;
+    stream_len = sizeof(data);
+    stream_pos = 0;
+    stream_max_chunk = 0;
+    CHECK(jpegdec_input(&jd, buf, 2) == 2 && buf[1] == 1);
+    CHECK(jpegdec_input(&jd, NULL, 150) == 150 && stream_pos == 152);
+    CHECK(stream_max_chunk <= JPEGDEC_SKIP_SIZE);
+    CHECK(jpegdec_input(&jd, buf, 1) == 1 && buf[0] == 152);
+    // A skip past the end of the stream stops short
+    CHECK(jpegdec_input(&jd, NULL, 100) == 47);
+}
+
+static void test_output_fb(void) {
+    uint16_t fb[3][4];
+    memset(fb, 0, sizeof(fb));
+    jpegdec_ctx_t ctx = { .fb = &fb[0][0], .fb_width = 4, .fb_height = 3, .x = -1, .y = -1 };
+    JDEC jd = { .device = &ctx };
+
+    // A 3x3 block hanging off the top left corner
+    uint8_t block[] = { PIX(1), PIX(2), PIX(3), PIX(4), PIX(5), PIX(6), PIX(7), PIX(8), PIX(9) };
+    JRECT rect = { .left = 0, .right = 2, .top = 0, .bottom = 2 };
+    CHECK(jpegdec_output_fb(&jd, block, &rect) == 1);
+    CHECK(fb[0][0] == rgb565(5) && fb[0][1] == rgb565(6) && fb[0][2] == 0);
+    CHECK(fb[1][0] == rgb565(8) && fb[1][1] == rgb565(9) && fb[1][2] == 0);
+    CHECK(fb[2][0] == 0);
+
+    // The same block hanging off the bottom right corner
+    rect = (JRECT){ .left = 3, .right = 5, .top = 2, .bottom = 4 };
+    CHECK(jpegdec_output_fb(&jd, block, &rect) == 1);
+    CHECK(fb[1][2] == rgb565(1) && fb[1][3] == rgb565(2));
+    CHECK(fb[2][2] == rgb565(4) && fb[2][3] == rgb565(5));
+
+    // Entirely outside
+    memset(fb, 0, sizeof(fb));
+    rect = (JRECT){ .left = 8, .right = 10, .top = 0, .bottom = 2 };
+    CHECK(jpegdec_output_fb(&jd, block, &rect) == 1);
+    rect = (JRECT){ .left = 0, .right = 2, .top = 6, .bottom = 8 };
+    CHECK(jpegdec_output_fb(&jd, block, &rect) == 1);
+    for (int i = 0; i < 12; i++) {
+        CHECK((&fb[0][0])[i] == 0);
+    }
+}
+
+// Rows handed to the bus, as (buffer, length, first)
+static const uint16_t *sent_row[4];
+static size_t sent_len[4];
+static bool sent_first[4];
+static uint16_t sent_px[4][8];
+static int n_sent;
+static int fail_at = -1;
+
+static bool send_row(jpegdec_ctx_t *ctx, const uint16_t *row, size_t len, bool first) {
+    (void)ctx;
+    if (n_sent == fail_at) {
+        return false;
+    }
+    sent_row[n_sent] = row;
+    sent_len[n_sent] = len;
+    sent_first[n_sent] = first;
+    memcpy(sent_px[n_sent], row, len * sizeof(*row));
+    n_sent++;
+    return true;
+}
+
+static void test_output_rows(void) {
+    // A 4 pixel wide image with 2x2 blocks: two blocks per MCU row
+    uint16_t rows[2][8];
+    jpegdec_ctx_t ctx = { .out_width = 4, .rows = { rows[0], rows[1] }, .send_row = send_row };
+    JDEC jd = { .msy = 1, .width = 4, .height = 4, .device = &ctx };
+    CHECK(jpegdec_row_pixels(&jd, 0) == 32);
+    // Scaled MCUs are at least one pixel high
+    JDEC wide = { .msy = 1, .width = 64 };
+    CHECK(jpegdec_row_pixels(&wide, 3) == 8);
+
+    uint8_t left[] = { PIX(1), PIX(2), PIX(5), PIX(6) };
+    uint8_t right[] = { PIX(3), PIX(4), PIX(7), PIX(8) };
+    JRECT rect = { .left = 0, .right = 1, .top = 0, .bottom = 1 };
+    CHECK(jpegdec_output_rows(&jd, left, &rect) == 1 && n_sent == 0);
+    rect = (JRECT){ .left = 2, .right = 3, .top = 0, .bottom = 1 };
+    CHECK(jpegdec_output_rows(&jd, right, &rect) == 1 && n_sent == 1);
+    CHECK(sent_row[0] == rows[0] && sent_len[0] == 8 && sent_first[0]);
+    for (int i = 0; i < 8; i++) {
+        CHECK(sent_px[0][i] == rgb565(i + 1));
+    }
+
+    // The next MCU row goes to the other buffer and continues the write
+    rect = (JRECT){ .left = 0, .right = 1, .top = 2, .bottom = 3 };
+    jpegdec_output_rows(&jd, left, &rect);
+    rect = (JRECT){ .left = 2, .right = 3, .top = 2, .bottom = 3 };
+    CHECK(jpegdec_output_rows(&jd, right, &rect) == 1 && n_sent == 2);
+    CHECK(sent_row[1] == rows[1] && !sent_first[1]);
+    CHECK(sent_px[1][0] == rgb565(1) && sent_px[1][7] == rgb565(8));
+
+    // A failed send interrupts the decode
+    fail_at = 2;
+    rect = (JRECT){ .left = 2, .right = 3, .top = 4, .bottom = 5 };
+    CHECK(jpegdec_output_rows(&jd, right, &rect) == 0);
+}
+
+int main(void) {
+    test_convert();
+    test_input();
+    test_output_fb();
+    test_output_rows();
+    return check_result("test_jpegdec");
+}
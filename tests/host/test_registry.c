@@ -0,0 +1,188 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Brad Barnett
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Registry lifecycle with stubbed delete functions standing in for the
+ * esp_lcd, spi_master and GPIO calls.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "check.h"
+#include "registry.h"
+
+// Stand-ins for the bus type objects
+static const int spibus_type;
+static const int i80bus_type;
+
+// A driver object.  alive is false once its heap has been reset.
+typedef struct {
+    bool alive;
+    void *io_handle;
+    bool detached;
+} owner_t;
+
+// Handles deleted so far, in order
+static void *deleted[16];
+static int n_deleted;
+static void *fail_handle;                   // del of this handle fails
+
+static int del_stub(void *handle) {
+    if (handle == fail_handle) {
+        return 0x103;                       // ESP_ERR_INVALID_STATE
+    }
+    deleted[n_deleted++] = handle;
+    return 0;
+}
+
+static bool owner_alive(const registry_entry_t *entry) {
+    const owner_t *owner = entry->owner;
+    return owner->alive && owner->io_handle == entry->handles[1].handle;
+}
+
+static void detach(void *owner_in) {
+    owner_t *owner = owner_in;
+    owner->io_handle = NULL;
+    owner->detached = true;
+}
+
+static registry_entry_t entries[2];
+static registry_t reg = { entries, 2, owner_alive, detach };
+
+static void reset(void) {
+    memset(entries, 0, sizeof(entries));
+    n_deleted = 0;
+    fail_handle = NULL;
+}
+
+// Create a bus the way the constructors do: claim, allocate, then register
+static registry_entry_t *create(owner_t *owner, const void *type, int id, char *handles) {
+    int err;
+    registry_entry_t *entry = registry_claim(&reg, type, id, &err);
+    if (entry == NULL) {
+        return NULL;
+    }
+    *owner = (owner_t){ .alive = true, .io_handle = &handles[1] };
+    for (int i = 0; i < REGISTRY_HANDLES; i++) {
+        entry->handles[i] = (registry_handle_t){ &handles[i], del_stub };
+    }
+    registry_own(&reg, entry, owner);
+    return entry;
+}
+
+static void test_claim(void) {
+    reset();
+    char a[3], b[3], c[3];
+    owner_t oa, ob, oc;
+    int err;
+
+    registry_entry_t *ea = create(&oa, &spibus_type, 1, a);
+    registry_entry_t *eb = create(&ob, &i80bus_type, 1, b);
+    CHECK(ea != NULL && eb != NULL && ea != eb);
+    CHECK(registry_find(&reg, &spibus_type, 1) == ea);
+    CHECK(registry_find(&reg, &i80bus_type, 1) == eb);
+
+    // Full: a new key is refused without touching the others
+    CHECK(create(&oc, &spibus_type, 2, c) == NULL);
+    CHECK(registry_claim(&reg, &spibus_type, 2, &err) == NULL && err == 0);
+    CHECK(n_deleted == 0 && !oa.detached && !ob.detached);
+
+    // Releasing one frees its slot
+    CHECK(registry_release_owned(&reg, &spibus_type, 1, &oa) == 0);
+    CHECK(n_deleted == 3 && deleted[0] == &a[0] && deleted[1] == &a[1] && deleted[2] == &a[2]);
+    CHECK(create(&oc, &spibus_type, 2, c) != NULL);
+}
+
+static void test_takeover(void) {
+    reset();
+    char a[3], b[3];
+    owner_t oa, ob;
+
+    create(&oa, &spibus_type, 1, a);
+    registry_entry_t *entry = create(&ob, &spibus_type, 1, b);
+    // The old handles are freed in order and the live old owner is detached
+    CHECK(n_deleted == 3 && deleted[0] == &a[0] && deleted[1] == &a[1] && deleted[2] == &a[2]);
+    CHECK(oa.detached && oa.io_handle == NULL);
+    CHECK(entry->owner == &ob && !ob.detached);
+
+    // Reuse without release, as RGBFrameBuffer does for a matching config
+    owner_t oc = { .alive = true, .io_handle = &b[1] };
+    registry_own(&reg, entry, &oc);
+    CHECK(ob.detached && entry->owner == &oc && n_deleted == 3);
+}
+
+static void test_deinit_by_non_owner(void) {
+    reset();
+    char a[3], b[3];
+    owner_t oa, ob;
+
+    create(&oa, &spibus_type, 1, a);
+    registry_entry_t *entry = create(&ob, &spibus_type, 1, b);
+    n_deleted = 0;
+
+    // The finaliser of the old object runs after the takeover
+    CHECK(registry_release_owned(&reg, &spibus_type, 1, &oa) == 0);
+    CHECK(n_deleted == 0 && entry->owner == &ob && entry->handles[1].handle == &b[1]);
+    CHECK(!ob.detached);
+
+    CHECK(registry_release_owned(&reg, &spibus_type, 1, &ob) == 0);
+    CHECK(n_deleted == 3 && ob.detached);
+    CHECK(registry_find(&reg, &spibus_type, 1) == NULL);
+}
+
+static void test_stale_owner(void) {
+    reset();
+    char a[3], b[3];
+    owner_t oa, ob;
+
+    create(&oa, &spibus_type, 1, a);
+    // Soft reset: the heap is gone but the entry and its handles remain
+    oa.alive = false;
+    registry_entry_t *entry = create(&ob, &spibus_type, 1, b);
+    CHECK(entry != NULL);
+    CHECK(n_deleted == 3 && deleted[0] == &a[0]);
+    CHECK(!oa.detached);
+
+    // Memory reused for an unrelated object with a different handle
+    owner_t oc = { .alive = true, .io_handle = &a[1] };
+    entry->owner = &oc;
+    n_deleted = 0;
+    CHECK(registry_release(&reg, entry) == 0);
+    CHECK(!oc.detached && n_deleted == 3);
+}
+
+static void test_failed_release(void) {
+    reset();
+    char a[3], b[3];
+    owner_t oa, ob;
+    int err;
+
+    create(&oa, &spibus_type, 1, a);
+    fail_handle = &a[2];
+    CHECK(registry_claim(&reg, &spibus_type, 1, &err) == NULL && err == 0x103);
+    // The entry keeps the handle that failed and stays reserved
+    registry_entry_t *entry = registry_find(&reg, &spibus_type, 1);
+    CHECK(entry != NULL && entry->owner == NULL);
+    CHECK(entry->handles[0].del == NULL && entry->handles[1].del == NULL);
+    CHECK(entry->handles[2].del != NULL && entry->handles[2].handle == &a[2]);
+    CHECK(oa.detached);
+
+    // The next claim retries only what is left
+    fail_handle = NULL;
+    n_deleted = 0;
+    CHECK(create(&ob, &spibus_type, 1, b) == entry);
+    CHECK(n_deleted == 1 && deleted[0] == &a[2]);
+}
+
+int main(void) {
+    test_claim();
+    test_takeover();
+    test_deinit_by_non_owner();
+    test_stale_owner();
+    test_failed_release();
+    return check_result("test_registry");
+}
@@ -0,0 +1,185 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Brad Barnett
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * send_rect row transmit against a stub IO that records every transfer.
+ * Transfers complete as soon as they are queued.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "rows.h"
+
+#define MAX_TX (512)
+
+typedef struct {
+    int cmd;
+    const uint8_t *buf;
+    size_t len;
+    uint8_t first_byte;                     // buf[0] when queued
+    uint8_t prev_first_byte;                // first byte of the previous buffer when this one was queued
+} tx_t;
+
+static tx_t tx[MAX_TX];
+static int n_tx;
+static int fail_at = -1;
+static volatile uint32_t trans_count;
+
+static void *allocs[2];
+static size_t alloc_len[2];
+static int n_alloc;
+static int n_free;
+static bool fail_alloc;
+
+static int tx_stub(void *ctx, int cmd, const void *buf, size_t len) {
+    (void)ctx;
+    if (n_tx == fail_at) {
+        return 0x107;                       // ESP_ERR_TIMEOUT
+    }
+    tx[n_tx] = (tx_t){ cmd, buf, len, ((const uint8_t *)buf)[0], 0 };
+    if (n_tx > 0) {
+        tx[n_tx].prev_first_byte = tx[n_tx - 1].buf[0];
+    }
+    n_tx++;
+    trans_count++;
+    return 0;
+}
+
+static void *malloc_stub(size_t size) {
+    if (fail_alloc && n_alloc == 1) {
+        return NULL;
+    }
+    void *p = malloc(size);
+    allocs[n_alloc & 1] = p;
+    alloc_len[n_alloc & 1] = size;
+    n_alloc++;
+    return p;
+}
+
+static void free_stub(void *p) {
+    if (p != NULL) {
+        n_free++;
+    }
+    free(p);
+}
+
+static const rows_io_t io = { NULL, tx_stub, &trans_count, malloc_stub, free_stub };
+
+static void reset(void) {
+    n_tx = 0;
+    fail_at = -1;
+    n_alloc = 0;
+    n_free = 0;
+    fail_alloc = false;
+}
+
+static void test_rect_offset(void) {
+    size_t offset;
+    // 10x4 canvas
+    CHECK(rows_rect_offset(80, 10, 0, 0, 10, 4, &offset) && offset == 0);
+    CHECK(rows_rect_offset(80, 10, 2, 1, 3, 2, &offset) && offset == 12);
+    CHECK(rows_rect_offset(80, 10, 9, 3, 1, 1, &offset) && offset == 39);
+    // The last row only needs x + w pixels
+    CHECK(rows_rect_offset(2 * 35, 10, 2, 2, 3, 2, &offset) && offset == 22);
+    CHECK(!rows_rect_offset(2 * 34, 10, 2, 2, 3, 2, &offset));
+
+    CHECK(!rows_rect_offset(80, 10, 0, 0, 0, 1, &offset));
+    CHECK(!rows_rect_offset(80, 10, 0, 0, 1, 0, &offset));
+    CHECK(!rows_rect_offset(80, 10, 8, 0, 3, 1, &offset));
+    CHECK(!rows_rect_offset(80, 10, 0, 0, 11, 1, &offset));
+    CHECK(!rows_rect_offset(80, 10, 0, 3, 1, 2, &offset));
+    CHECK(!rows_rect_offset(80, 10, 0, 4, 1, 1, &offset));
+    CHECK(!rows_rect_offset(80, 0, 0, 0, 1, 1, &offset));
+
+    // Values that overflow x + w, y * stride or y + h
+    CHECK(!rows_rect_offset(80, 10, SIZE_MAX, 0, 2, 1, &offset));
+    CHECK(!rows_rect_offset(80, SIZE_MAX, 1, 0, SIZE_MAX, 1, &offset));
+    CHECK(!rows_rect_offset(80, 10, 0, SIZE_MAX / 10 + 1, 1, 1, &offset));
+    CHECK(!rows_rect_offset(80, 10, 0, 1, 1, SIZE_MAX, &offset));
+    CHECK(!rows_rect_offset(SIZE_MAX, SIZE_MAX / 2, 0, 3, 1, 1, &offset));
+}
+
+static void test_send(void) {
+    reset();
+    static uint8_t canvas[40 * 10 * 2];
+    const uint8_t *src = canvas + 2 * (40 * 2 + 5);
+    trans_count = 7;
+
+    CHECK(rows_send(&io, 0x2C, src, 80, 16, 6) == 0);
+    CHECK(n_tx == 6 && n_alloc == 0);
+    for (int i = 0; i < 6; i++) {
+        // Straight from the canvas, one transfer per row
+        CHECK(tx[i].buf == src + i * 80 && tx[i].len == 16);
+        CHECK(tx[i].cmd == (i == 0 ? 0x2C : -1));
+    }
+
+    // A failed transfer stops the rect
+    reset();
+    fail_at = 2;
+    CHECK(rows_send(&io, 0x2C, src, 80, 16, 6) == 0x107 && n_tx == 2);
+}
+
+static void test_send_staged(void) {
+    // 320x240 canvas, 100x50 rect at (10, 20).  Each byte encodes its row.
+    const size_t stride = 320, w = 100, h = 50;
+    uint8_t *canvas = malloc(stride * 240 * 2);
+    for (size_t y = 0; y < 240; y++) {
+        memset(canvas + y * stride * 2, (uint8_t)y, stride * 2);
+    }
+    const uint8_t *src = canvas + 2 * (20 * stride + 10);
+
+    reset();
+    CHECK(rows_send_staged(&io, 0x2C, src, 2 * stride, 2 * w, h, 4096) == 0);
+    // 4096 / 200 = 20 rows per chunk: 20, 20, 10
+    CHECK(n_alloc == 2 && alloc_len[0] == 4000 && alloc_len[1] == 4000 && n_free == 2);
+    CHECK(n_tx == 3);
+    CHECK(tx[0].len == 4000 && tx[1].len == 4000 && tx[2].len == 2000);
+    for (int k = 0; k < n_tx; k++) {
+        CHECK(tx[k].cmd == (k == 0 ? 0x2C : -1));
+        // Ping-pong: chunks alternate and never point into the canvas
+        CHECK(tx[k].buf == allocs[k & 1]);
+        // Filling a chunk left the previous one, still in flight, untouched
+        CHECK(tx[k].first_byte == (uint8_t)(20 + 20 * k));
+        if (k > 0) {
+            CHECK(tx[k].prev_first_byte == (uint8_t)(20 + 20 * (k - 1)));
+        }
+    }
+
+    // A whole-width strip is still staged in small chunks, not as one block
+    reset();
+    CHECK(rows_send_staged(&io, 0x2C, canvas, 2 * stride, 2 * stride, 240, 4096) == 0);
+    CHECK(alloc_len[0] == 3840 && alloc_len[1] == 3840);
+    CHECK(n_tx == 40 && tx[39].len == 3840);
+
+    // Rows wider than the staging size get a chunk each
+    reset();
+    CHECK(rows_send_staged(&io, 0x2C, canvas, 2 * stride, 2 * stride, 3, 512) == 0);
+    CHECK(alloc_len[0] == 640 && n_tx == 3);
+
+    // Staging memory exhausted
+    reset();
+    fail_alloc = true;
+    CHECK(rows_send_staged(&io, 0x2C, src, 2 * stride, 2 * w, h, 4096) == -1);
+    CHECK(n_tx == 0 && n_free == 1);
+
+    // A failed transfer stops the rect and frees the chunks
+    reset();
+    fail_at = 1;
+    CHECK(rows_send_staged(&io, 0x2C, src, 2 * stride, 2 * w, h, 4096) == 0x107);
+    CHECK(n_tx == 1 && n_free == 2);
+
+    free(canvas);
+}
+
+int main(void) {
+    test_rect_offset();
+    test_send();
+    test_send_staged();
+    return check_result("test_rows");
+}
@@ -0,0 +1,128 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Brad Barnett
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * TE pacing bookkeeping driven by a simulated TE source: edges with synthetic
+ * timestamps go through te_edge as the interrupt would send them.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "check.h"
+#include "te.h"
+
+static bus_te_t te;
+
+static void reset(void) {
+    memset(&te, 0, sizeof(te));
+    te.gpio = -1;
+}
+
+// Feed n edges period us apart, starting one period after t, and return the
+// time of the last one
+static uint32_t edges(uint32_t t, uint32_t period, int n) {
+    for (int i = 0; i < n; i++) {
+        t += period;
+        te_edge(&te, t);
+    }
+    return t;
+}
+
+static void test_period(void) {
+    reset();
+    // The first edge only records the time
+    te_edge(&te, 1000);
+    CHECK(te.frames == 1 && te.last == 1000 && te.period == 0);
+
+    // 60 Hz
+    uint32_t t = edges(1000, 16667, 1);
+    CHECK(te.frames == 2 && te.period == 16667);
+    t = edges(t, 16667, 20);
+    CHECK(te.period == 16667);
+    CHECK(1000000 / te.period == 59);
+
+    // Dropping to 50 Hz moves the average an eighth of the way per frame
+    t = edges(t, 20000, 1);
+    CHECK(te.period == 16667 + (20000 - 16667) / 8);
+    t = edges(t, 20000, 60);
+    CHECK(te.period > 19900 && te.period <= 20000);
+    CHECK(1000000 / te.period == 50);
+
+    // Jitter around 60 Hz averages out
+    for (int i = 0; i < 40; i++) {
+        t = edges(t, i & 1 ? 16000 : 17334, 1);
+    }
+    CHECK(te.period > 16500 && te.period < 16850);
+    CHECK(te.last == t);
+}
+
+static void test_missed(void) {
+    reset();
+    // Nothing counts before the first paced wait
+    te_account(&te, 5);
+    CHECK(te.missed == 0);
+
+    te_synced(&te, 10);
+    CHECK(te.pacing && te.synced == 10);
+
+    // Gap 0: the next wait starts before another edge
+    te_account(&te, 10);
+    CHECK(te.missed == 0);
+    te_synced(&te, 11);
+
+    // Gap 1: one edge passed without a transfer
+    te_account(&te, 12);
+    CHECK(te.missed == 1);
+    te_synced(&te, 13);
+
+    // Up to TE_IDLE_FRAMES still counts
+    te_account(&te, 13 + TE_IDLE_FRAMES);
+    CHECK(te.missed == 1 + TE_IDLE_FRAMES);
+    te_synced(&te, 14 + TE_IDLE_FRAMES);
+
+    // A longer gap is idle time
+    te_account(&te, 14 + 2 * TE_IDLE_FRAMES + 1);
+    CHECK(te.missed == 1 + TE_IDLE_FRAMES);
+
+    // te_sync(False) or a timeout clears pacing, so the gap after it is free
+    te.pacing = false;
+    te_account(&te, 100);
+    CHECK(te.missed == 1 + TE_IDLE_FRAMES);
+}
+
+static void test_wrap(void) {
+    reset();
+    // The 32-bit microsecond clock wraps every 71 minutes
+    uint32_t t = UINT32_MAX - 20000;
+    te_edge(&te, t);
+    t = edges(t, 16667, 3);
+    CHECK(t == 30000);
+    CHECK(te.period == 16667 && te.last == t);
+
+    // So does the frame count
+    te.frames = UINT32_MAX;
+    t = edges(t, 16667, 1);
+    CHECK(te.frames == 0);
+    // The average keeps updating across the wrap
+    t = edges(t, 20000, 1);
+    CHECK(te.frames == 1 && te.period == 16667 + (20000 - 16667) / 8 && te.last == t);
+
+    // MAX - 1 to 1 passes MAX and 0
+    te_synced(&te, UINT32_MAX - 1);
+    te_account(&te, 1);
+    CHECK(te.missed == 3);
+    te_synced(&te, UINT32_MAX);
+    te_account(&te, UINT32_MAX + TE_IDLE_FRAMES + 2);
+    CHECK(te.missed == 3);
+}
+
+int main(void) {
+    test_period();
+    test_missed();
+    test_wrap();
+    return check_result("test_te");
+}